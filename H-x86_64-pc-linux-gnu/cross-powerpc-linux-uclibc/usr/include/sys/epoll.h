@@ -23,6 +23,15 @@
 #include <sys/types.h>
 
 
+/* Flags to be passed to the epoll_create1 system call (SYS_epoll_create1).
+   This matches O_CLOEXEC from <bits/fcntl.h>.  */
+enum
+  {
+    EPOLL_CLOEXEC = 02000000
+#define EPOLL_CLOEXEC EPOLL_CLOEXEC
+  };
+
+
 enum EPOLL_EVENTS
   {
     EPOLLIN = 0x001,
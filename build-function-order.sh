@@ -0,0 +1,355 @@
+#!/bin/bash
+#
+# Linux Shell Script For Profile Driven Function Ordering (GC/Wii PowerPC)
+# Written by DeltaResero <deltaresero[at]zoho.com>
+#
+# Permission is hereby granted, free of charge, to any person obtaining a
+# copy of this software and associated documentation files (the "Software"),
+# to deal in the Software without restriction, including without limitation
+# on the rights to use, copy, modify, merge, publish, distribute, sub
+# license, and/or sell copies of the Software, and to permit persons to whom
+# the Software is furnished to do so, subject to the following conditions:
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+#
+#
+
+
+# Turns a profile (gprof flat profile, perf report or plain "weight function"
+# lines) into a function order and a linker script that places those functions
+# first in .text, hottest first, so the hot code of a program shares as few
+# 750CL I-cache sets and pages as possible.  The program has to be compiled
+# with -ffunction-sections for its functions to be movable, and is linked with
+# -Wl,-T,NAME.ld.  ld 2.19 has no ordering file option of its own, so the order
+# is written into a copy of the linker's default script instead.
+usage()
+{
+  printf "Usage: %s [options] PROFILE...\n\n" "$0"
+  printf "  -x, --cross-compile PREFIX  toolchain prefix, or 'native' when running on the target\n"
+  printf "                              itself (default: the build-ppc-toolchain.sh toolchain in\n"
+  printf "                              H-<host>-pc-linux-gnu/cross-powerpc-linux-uclibc-ng when\n"
+  printf "                              it's there, otherwise the included 2009 one for writing\n"
+  printf "                              the order and powerpc-linux- from the PATH for -b)\n"
+  printf "  -o, --output NAME           write NAME.txt (the order) and NAME.ld (the linker\n"
+  printf "                              script) (default: function-order)\n"
+  printf "  -c, --coverage PERCENT      order the hottest functions making up PERCENT of the\n"
+  printf "                              profile, the rest stay in link order (default: 95)\n"
+  printf "  -b, --benchmark             build a synthetic I-cache test program in link order and\n"
+  printf "                              in profile order, to be timed on the console (no PROFILE\n"
+  printf "                              needed)\n"
+  printf "  -h, --help                  show this help and exit\n"
+  printf "\nProfiles, all of them are added up:\n"
+  printf "  gprof -b -p --no-demangle PROGRAM gmon.out > PROFILE\n"
+  printf "  perf report --stdio --no-demangle > PROFILE\n"
+  printf "  or any list of \"weight function\" lines (e.g. sample counts)\n"
+}
+
+crossPrefix=''
+outputName='function-order'
+coverage='95'
+runBenchmark='no'
+profiles=()
+
+# Reads the command line options
+while [[ $# -gt 0 ]]; do
+  case $1 in
+    -x|--cross-compile|-o|--output|-c|--coverage)
+      if [[ -z $2 ]]; then
+        printf "Error, option '%s' requires a value\n\n" "$1"
+        usage
+        exit 1
+      fi
+      case $1 in
+        -x|--cross-compile) crossPrefix=$2;;
+        -o|--output) outputName=$2;;
+        -c|--coverage) coverage=$2;;
+      esac
+      shift 2;;
+    -b|--benchmark) runBenchmark='yes'
+      shift;;
+    -h|--help) usage
+      exit 0;;
+    -*) printf "Error, unknown option '%s'\n\n" "$1"
+      usage
+      exit 1;;
+    *) profiles+=("$1")
+      shift;;
+  esac
+done
+
+# The included 2009 toolchain has no cc1 or target libraries, so it can only
+# link; the one from build-ppc-toolchain.sh is used when it has been built.
+# Without it, writing the order only needs ld, which the 2009 one has.
+if [[ ${crossPrefix} == 'native' ]]; then
+  crossPrefix=''
+elif [[ -z ${crossPrefix} ]]; then
+  crossPrefix="${PWD}/H-$(uname -m)-pc-linux-gnu/cross-powerpc-linux-uclibc-ng/usr/bin/powerpc-linux-"
+  if [[ ! -x ${crossPrefix}gcc ]]; then
+    if [[ $(uname -m) == 'x86_64' ]]; then
+      TOOLCHAIN_DIRECTORY="${PWD}/H-x86_64-pc-linux-gnu/cross-powerpc-linux-uclibc"
+    else
+      TOOLCHAIN_DIRECTORY="${PWD}/H-i686-pc-linux-gnu/cross-powerpc-linux-uclibc"
+    fi
+    if [[ ${runBenchmark} != 'yes' && -x $TOOLCHAIN_DIRECTORY/usr/bin/powerpc-linux-ld ]]; then
+      export LD_LIBRARY_PATH=$TOOLCHAIN_DIRECTORY/usr/lib
+      crossPrefix="$TOOLCHAIN_DIRECTORY/usr/bin/powerpc-linux-"
+    else
+      crossPrefix='powerpc-linux-'
+    fi
+  fi
+fi
+
+if [[ ! ${coverage} =~ ^[1-9][0-9]?$|^100$ ]]; then
+  printf "Error, the coverage must be a percentage from 1 to 100\n"
+  exit 1
+fi
+
+if [[ ${runBenchmark} != 'yes' && ${#profiles[@]} -eq 0 ]]; then
+  usage
+  exit 1
+fi
+
+if ! type ${crossPrefix}ld > /dev/null 2>&1; then
+  printf "Error, ${crossPrefix}ld not found (add the toolchain's usr/bin to the PATH or use -x)\n"
+  exit 1
+fi
+
+# The benchmark needs a compiler that can build and statically link C
+if [[ ${runBenchmark} == 'yes' ]]; then
+  if ! printf 'int main(void) { return 0; }\n' | ${crossPrefix}gcc -static -x c -o /dev/null - > /dev/null 2>&1; then
+    printf "Error, ${crossPrefix}gcc can't build a static C program for the benchmark\n"
+    printf "(the included 2009 toolchain can't, build one with ./build-ppc-toolchain.sh or use -x)\n"
+    exit 1
+  fi
+fi
+
+export LC_ALL=C
+#------------------------------------------------------------------------------
+
+
+# Prints "weight function" for every function in the profiles, hottest
+# first; perf lines are "12.34%  command  object  [.] function", gprof flat
+# profile lines are "%time cumulative self [calls self total] function".
+# Each profile counts as 100 (whatever its units), so they can be mixed.
+readProfiles()
+{
+  awk '
+    function number(text) { return text ~ /^[0-9]+(\.[0-9]+)?$/ }
+    function add(name, value) {
+      if (value > 0 && name ~ /^[A-Za-z_.$][A-Za-z0-9_.$]*$/) {
+        weight[FILENAME, name] += value
+        total[FILENAME] += value
+      }
+    }
+    $1 ~ /^[0-9.]+%$/ {
+      for (i = 2; i < NF; i++)
+        if ($i == "[.]" || $i == "[k]") { add($(i + 1), $1 + 0); next }
+    }
+    NF >= 4 && number($1) && number($2) && number($3) { add($NF, $3); next }
+    NF == 2 && number($1) { add($2, $1) }
+    END {
+      for (key in weight) {
+        split(key, part, SUBSEP)
+        sum[part[2]] += 100 * weight[key] / total[part[1]]
+      }
+      for (name in sum) print sum[name], name
+    }' "$@" | sort -k 1,1gr -k 2,2
+}
+
+# Writes the order ($1.txt) for the profiles given after it, and the linker
+# script ($1.ld): the default script of the linker with the hot/unlikely
+# grouping of newer binutils and the ordered functions at the start of .text
+writeOrder()
+{
+  local name=$1
+  shift
+  readProfiles "$@" | awk -v coverage=${coverage} '
+    { weight[NR] = $1; function_[NR] = $2; total += $1 }
+    END {
+      print "# function, share of the profile (%), cumulative share (%)"
+      for (i = 1; i <= NR && sum < total * coverage / 100; i++) {
+        sum += weight[i]
+        printf "%s %.2f %.2f\n", function_[i], 100 * weight[i] / total, 100 * sum / total
+      }
+    }' > ${name}.txt
+
+  ${crossPrefix}ld --verbose | awk '/^==========/ { inside = !inside; next } inside' > ${name}.ld.base
+  if ! grep -q '^  \.text[ \t]*:' ${name}.ld.base; then
+    printf "Error, no .text output section in the default linker script of ${crossPrefix}ld\n"
+    rm -f ${name}.ld.base
+    exit 1
+  fi
+  if ! grep -q '\.text\.hot' ${name}.ld.base; then
+    sed -i 's/^    \*(\.text \.stub \.text\.\* \.gnu\.linkonce\.t\.\*)$/    *(.text.unlikely .text.*_unlikely .text.unlikely.*)\n    *(.text.exit .text.exit.*)\n    *(.text.startup .text.startup.*)\n    *(.text.hot .text.hot.*)\n    *(.text .stub .text.* .gnu.linkonce.t.*)/' ${name}.ld.base
+  fi
+  awk -v order=${name}.txt '
+    /^  \.text[ \t]*:/ { text = 1 }
+    { print }
+    text && /^  \{/ {
+      print "    /* Profile order from build-function-order.sh, hottest first */"
+      while ((getline line < order) > 0)
+        if (line !~ /^#/) {
+          split(line, field, " ")
+          printf "    *(.text.hot.%s .text.%s)\n", field[1], field[1]
+        }
+      text = 0
+    }' ${name}.ld.base > ${name}.ld
+  rm -f ${name}.ld.base
+}
+
+if [[ ${#profiles[@]} -gt 0 ]]; then
+  writeOrder ${outputName} "${profiles[@]}"
+  printf "Ordered $(grep -vc '^#' ${outputName}.txt) functions covering $(tail -n 1 ${outputName}.txt | awk '{ print $3 }')%% of the profile\n"
+  head -n 11 ${outputName}.txt
+  printf "\nOrder: ${outputName}.txt, linker script: ${outputName}.ld\n"
+  printf "Compile with -ffunction-sections and link with -Wl,-T,${outputName}.ld\n"
+fi
+#------------------------------------------------------------------------------
+
+
+# Benchmark: 256 functions of 512 bytes (128 KB of code, four times the
+# 750CL's 32 KB I-cache), of which every 8th one is hot.  In link order the hot
+# functions are 4 KB apart, so they all fall into the same few sets of the
+# 8-way I-cache and into 32 different pages; in profile order they're 16 KB
+# in a row.  The hot loop is timed with the timebase on PowerPC (and the
+# monotonic clock anywhere else), the best of 5 rounds is shown.  qemu doesn't
+# model caches, so the times only mean something on the console itself; when
+# cross compiling this only builds the programs and shows where their hot code
+# lands, it doesn't measure anything.
+if [[ ${runBenchmark} == 'yes' ]]; then
+  BENCH_DIRECTORY="${outputName}-benchmark"
+  mkdir -p $BENCH_DIRECTORY
+  printf "\n- Function Order Test Program -\n"
+
+  {
+    cat <<'EOF'
+/* Generated by build-function-order.sh --benchmark */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#if defined(__powerpc__)
+#define PADDING ".rept 120\n\tnop\n\t.endr"
+#define UNITS "timebase ticks"
+static unsigned long long ticks(void)
+{
+  unsigned int upper, lower, check;
+
+  do {
+    __asm__ __volatile__("mftbu %0" : "=r" (upper));
+    __asm__ __volatile__("mftb %0" : "=r" (lower));
+    __asm__ __volatile__("mftbu %0" : "=r" (check));
+  } while (upper != check);
+  return ((unsigned long long)upper << 32) | lower;
+}
+#else
+#define PADDING ".rept 480\n\tnop\n\t.endr"
+#define UNITS "ns"
+static unsigned long long ticks(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+#endif
+
+#define FUNCTION(n) int __attribute__((noinline, aligned(512))) f##n(int x) { __asm__ __volatile__(PADDING); return x + n; }
+EOF
+    for (( i = 0; i < 256; i++ )); do
+      echo "FUNCTION($i)"
+    done
+    printf "\nint (*const hot[])(int) = {"
+    for (( i = 0; i < 256; i += 8 )); do
+      printf " f$i,"
+    done
+    printf " 0 };\nint (*const cold[])(int) = {"
+    for (( i = 0; i < 256; i++ )); do
+      (( i % 8 )) && printf " f$i,"
+    done
+    cat <<'EOF'
+ 0 };
+
+int main(int argc, char *argv[])
+{
+  int passes = argc > 1 ? atoi(argv[1]) : 20000;
+  unsigned long long start, best = 0;
+  int round, pass, i, sum = 0;
+
+  /* Every function runs once so nothing is left out, then only the hot ones */
+  for (i = 0; cold[i]; i++)
+    sum += cold[i](i);
+  for (round = 0; round < 5; round++) {
+    start = ticks();
+    for (pass = 0; pass < passes; pass++)
+      for (i = 0; hot[i]; i++)
+        sum = hot[i](sum);
+    start = ticks() - start;
+    if (!best || start < best)
+      best = start;
+  }
+  printf("%.1f %s per pass (%d passes, best of 5, checksum %d)\n", (double)best / passes, UNITS, passes, sum);
+  return 0;
+}
+EOF
+  } > $BENCH_DIRECTORY/benchmark.c
+
+  # The benchmark's own profile: the hot functions, as sampling would see them
+  for (( i = 0; i < 256; i += 8 )); do
+    echo "1000 f$i"
+  done > $BENCH_DIRECTORY/benchmark.profile
+  coverage=100
+  writeOrder $BENCH_DIRECTORY/benchmark $BENCH_DIRECTORY/benchmark.profile
+
+  if ! ${crossPrefix}gcc -O2 -ffunction-sections -c -o $BENCH_DIRECTORY/benchmark.o $BENCH_DIRECTORY/benchmark.c ||
+     ! ${crossPrefix}gcc -static -o $BENCH_DIRECTORY/benchmark-link-order $BENCH_DIRECTORY/benchmark.o ||
+     ! ${crossPrefix}gcc -static -Wl,-T,$BENCH_DIRECTORY/benchmark.ld -o $BENCH_DIRECTORY/benchmark-profile-order $BENCH_DIRECTORY/benchmark.o; then
+    printf "Error, building the benchmark with ${crossPrefix}gcc failed\n"
+    exit 1
+  fi
+
+  # Where the hot code ended up: its span, and the pages and I-cache sets
+  # (32 byte lines, 128 sets) it touches
+  for variant in link-order profile-order; do
+    ${crossPrefix}nm -S $BENCH_DIRECTORY/benchmark-${variant} | awk -v variant=${variant} -v profile=$BENCH_DIRECTORY/benchmark.profile '
+      function hex(digits,    i, value) {
+        value = 0
+        digits = tolower(digits)
+        for (i = 1; i <= length(digits); i++)
+          value = value * 16 + index("0123456789abcdef", substr(digits, i, 1)) - 1
+        return value
+      }
+      BEGIN { while ((getline line < profile) > 0) { split(line, field, " "); hot[field[2]] = 1 } }
+      NF == 4 && ($4 in hot) {
+        start = hex($1); end = start + hex($2)
+        if (!low || start < low) low = start
+        if (end > high) high = end
+        for (address = start - start % 32; address < end; address += 32) {
+          pages[int(address / 4096)] = 1
+          sets[int(address / 32) % 128]++
+        }
+      }
+      END {
+        for (page in pages) pageCount++
+        for (set in sets) { setCount++; if (sets[set] > 8) conflicts++ }
+        printf "%-14s hot code spans %6.1f KB, %2d pages, %3d of 128 I-cache sets (%d sets need more than 8 ways)\n", variant ":", (high - low) / 1024, pageCount, setCount, conflicts
+      }'
+  done | tee $BENCH_DIRECTORY/report.txt
+
+  if [[ -z ${crossPrefix} ]]; then
+    for variant in link-order profile-order; do
+      printf "%-14s " "${variant}:"
+      $BENCH_DIRECTORY/benchmark-${variant}
+    done | tee -a $BENCH_DIRECTORY/report.txt
+  else
+    printf "\nCopy $BENCH_DIRECTORY/benchmark-link-order and benchmark-profile-order to the\n"
+    printf "GameCube / Wii and run both there (qemu doesn't model the caches), e.g.:\n"
+    printf "  ./benchmark-link-order 20000 && ./benchmark-profile-order 20000\n"
+  fi
+fi
@@ -21,8 +21,190 @@
 #
 
 
-# Set defaults and checks if arch is supported by this script 
-clear
+# Prints the command line options (all of them are optional, anything not
+# given on the command line is asked for interactively as before)
+usage()
+{
+  printf "Usage: %s [options]\n\n" "$0"
+  printf "  -t, --target TARGET      gamecube, wii or other (other uses the existing .config)\n"
+  printf "  -c, --config CONFIG      defconfig to start from (e.g. wii-mini-mode_defconfig)\n"
+  printf "                           or '.config' to build the existing configuration\n"
+  printf "  -x, --compiler COMPILER  bundled (gcLinux 2009 Buildroot), os (powerpc-linux-gnu-) or\n"
+  printf "                           modern (uClibc-ng toolchain made with build-ppc-toolchain.sh)\n"
+  printf "  -i, --incremental        skip 'make menuconfig' and 'make clean', and reuse the\n"
+  printf "                           existing .config when no target or config is given\n"
+  printf "  -o, --output DIR         build out of tree in DIR (kbuild O=), the .config, objects,\n"
+  printf "                           zImage, firmware, headers and modules all stay in DIR\n"
+  printf "  -O, --out-of-tree        same as --output build/CONFIG, one directory per defconfig\n"
+  printf "                           (e.g. build/wii-mini-mode and build/wii-ios-mode)\n"
+  printf "  -j, --jobs N             number of parallel make jobs (default: number of processors)\n"
+  printf "      --no-ccache          don't wrap the compiler in ccache (used by default when installed)\n"
+  printf "  -d, --distribute TOOL    distcc or icecc, hands compiles out to other hosts (through\n"
+  printf "                           ccache when it's used); the hosts need the same cross compiler\n"
+  printf "  -P, --profile-build      time every compiled object and write a per directory report\n"
+  printf "                           and a Chrome trace (chrome://tracing) into build-profile/\n"
+  printf "                           (this changes CC, so the first profiled build rebuilds all)\n"
+  printf "      --size-report        write a text/data/bss report per subsystem and a per symbol\n"
+  printf "                           diff against the saved baseline into size-report/\n"
+  printf "      --save-size-baseline use this build as the baseline for later size reports\n"
+  printf "      --size-budget KB     fail when vmlinux (text + data + bss) is larger than KB\n"
+  printf "      --initramfs          build the modules, firmware (and headers) into an initramfs,\n"
+  printf "                           append it to the ramdisk and rebuild zImage.initrd\n"
+  printf "      --initramfs-base DIR root filesystem folder to put into the initramfs as well\n"
+  printf "                           (otherwise the existing cpio ramdisk.image.gz is the base)\n"
+  printf "      --initramfs-headers  also put the kernel headers into the initramfs\n"
+  printf "      --compression-benchmark\n"
+  printf "                           rebuild zImage.initrd with the ramdisk in every available\n"
+  printf "                           format and compare sizes and decompression times\n"
+  printf "      --boot-test          boot the kernel in qemu-system-ppc (750 CPU), and report the\n"
+  printf "                           boot time and initcall times against the saved baseline\n"
+  printf "      --save-boot-baseline use this build as the baseline for later boot tests\n"
+  printf "      --qemu-machine NAME  qemu machine for the boot test (default: g3beige)\n"
+  printf "  -s, --strip              strip the zImage / zImage.initrd with sstrip\n"
+  printf "  -S, --no-strip           keep the zImage / zImage.initrd as is\n"
+  printf "  -h, --help               show this help and exit\n"
+  printf "\nExample (no prompts, rebuild only what changed):\n"
+  printf "  %s -t wii -c wii-mini-mode_defconfig -x bundled -i -S\n" "$0"
+  printf "\nOut of tree builds keep every variant warm and can run at the same time:\n"
+  printf "  %s -O -c wii-mini-mode_defconfig -x os -i -S &\n" "$0"
+  printf "  %s -O -c wii-ios-mode_defconfig -x os -i -S &\n" "$0"
+}
+
+buildTarget=''
+useConfig=''
+useCompiler=''
+useStrip=''
+incrementalBuild='no'
+buildDirectory=''
+outOfTree='no'
+numJobs=''
+useCcache='yes'
+useDistributed=''
+profileBuild='no'
+sizeReport='no'
+saveSizeBaseline='no'
+sizeBudget=''
+compressionBenchmark='no'
+buildInitramfs='no'
+initramfsBase=''
+initramfsHeaders='no'
+bootTest='no'
+saveBootBaseline='no'
+qemuMachine='g3beige'
+MACHINE_TYPE=`arch`
+
+# Reads the command line options
+while [[ $# -gt 0 ]]; do
+  case $1 in
+    -t|--target|-c|--config|-x|--compiler|-o|--output|-j|--jobs|-d|--distribute|--size-budget|--initramfs-base|--qemu-machine)
+      if [[ -z $2 ]]; then
+        printf "Error, option '%s' requires a value\n\n" "$1"
+        usage
+        exit 1
+      fi
+      case $1 in
+        -t|--target) buildTarget=$2;;
+        -c|--config) useConfig=$2;;
+        -x|--compiler) useCompiler=$2;;
+        -o|--output) buildDirectory=$2
+          outOfTree='yes';;
+        -j|--jobs) numJobs=$2;;
+        -d|--distribute) useDistributed=$2;;
+        --size-budget) sizeBudget=$2
+          sizeReport='yes';;
+        --initramfs-base) initramfsBase=$(cd "$2" && pwd) || exit 1
+          buildInitramfs='yes';;
+        --qemu-machine) qemuMachine=$2
+          bootTest='yes';;
+      esac
+      shift 2;;
+    -i|--incremental) incrementalBuild='yes'
+      shift;;
+    -O|--out-of-tree) outOfTree='yes'
+      shift;;
+    --no-ccache) useCcache='no'
+      shift;;
+    -P|--profile-build) profileBuild='yes'
+      shift;;
+    --size-report) sizeReport='yes'
+      shift;;
+    --save-size-baseline) saveSizeBaseline='yes'
+      sizeReport='yes'
+      shift;;
+    --compression-benchmark) compressionBenchmark='yes'
+      shift;;
+    --initramfs) buildInitramfs='yes'
+      shift;;
+    --initramfs-headers) initramfsHeaders='yes'
+      buildInitramfs='yes'
+      shift;;
+    --boot-test) bootTest='yes'
+      shift;;
+    --save-boot-baseline) saveBootBaseline='yes'
+      bootTest='yes'
+      shift;;
+    -s|--strip) useStrip='yes'
+      shift;;
+    -S|--no-strip) useStrip='no'
+      shift;;
+    -h|--help) usage
+      exit 0;;
+    *) printf "Error, unknown option '%s'\n\n" "$1"
+      usage
+      exit 1;;
+  esac
+done
+
+case ${buildTarget} in
+  '') ;;
+  gamecube|GameCube) buildTarget='GameCube';;
+  wii|Wii) buildTarget='Wii';;
+  other|Other|Unknown) buildTarget='Unknown'
+    useConfig='.config';;
+  *) printf "Error, unknown target '%s' (use gamecube, wii or other)\n" "${buildTarget}"
+    exit 1;;
+esac
+
+case ${useCompiler} in
+  ''|bundled|os|modern) ;;
+  *) printf "Error, unknown compiler '%s' (use bundled, os or modern)\n" "${useCompiler}"
+    exit 1;;
+esac
+
+case ${useDistributed} in
+  ''|distcc|icecc) ;;
+  *) printf "Error, unknown distributed compiler '%s' (use distcc or icecc)\n" "${useDistributed}"
+    exit 1;;
+esac
+
+if [[ -n ${numJobs} && ! ${numJobs} =~ ^[1-9][0-9]*$ ]]; then
+  printf "Error, the number of jobs must be a positive number\n"
+  exit 1
+fi
+
+if [[ -n ${sizeBudget} && ! ${sizeBudget} =~ ^[1-9][0-9]*$ ]]; then
+  printf "Error, the size budget must be a positive number of KB\n"
+  exit 1
+fi
+
+# An incremental build without a target or config keeps building the current .config
+if [[ ${incrementalBuild} == 'yes' && -z ${buildTarget} && -z ${useConfig} && -f "${buildDirectory:-.}/.config" ]]; then
+  useConfig='.config'
+fi
+
+# kbuild refuses to build out of tree while the source tree itself is configured
+if [[ ${outOfTree} == 'yes' && ( -f '.config' || -d 'include/config' ) ]]; then
+  printf "Error, out of tree builds need a clean source tree\n"
+  printf "Run 'make mrproper' here first (save the .config elsewhere if it's needed)\n"
+  exit 1
+fi
+#------------------------------------------------------------------------------
+
+
+# Set defaults and checks if arch is supported by this script
+if [[ -t 1 ]]; then
+  clear
+fi
 echo "This basic script is meant as a way to help with cross compiling"
 echo "GameCube and Wii Kernels.  While this isn't very robust, it should"
 echo -e "suffice for most basic compilations.\n"
@@ -36,19 +218,19 @@ echo -e "While there are other dependencies, these are the most common ones."
 echo "If any are missing, it's highly recommended that this script be stopped"
 echo -e "and these dependency packages be installed before continuing.\n"
 
-buildTarget=''
-useConfig=''
-MACHINE_TYPE=`arch`
-
 #Find number of processors for setting number of parallel jobs
 echo "- Processor Information -"
 echo "CPU Architecture: "${MACHINE_TYPE}
 numProcessors=$(grep -c ^processor /proc/cpuinfo)
 echo "Number of processors:" ${numProcessors}
+if [[ -n ${numJobs} ]]; then
+  numProcessors=${numJobs}
+  echo "Number of parallel jobs:" ${numProcessors}
+fi
 #------------------------------------------------------------------------------
 
 
-while : # Gets the user to select a console target (GameCube or Wii)
+while [[ -z ${buildTarget} && -z ${useConfig} ]] # Gets the user to select a console target (GameCube or Wii)
 do
   printf "\n\nEnter a value below matching the target platform or enter 4 to use '.config':\n"
   printf "(Selecting 'quit' at any time quit will exit this script)\n"
@@ -80,7 +262,10 @@ done
 #------------------------------------------------------------------------------
 
 
-if [[ ${buildTarget} != 'Unknown' ]]; then
+if [[ -n ${useConfig} ]]; then
+  printf "\n\nSelecting config: ${useConfig}\n"
+
+elif [[ ${buildTarget} != 'Unknown' ]]; then
   # Attempts to get user to select a base configuration to start with
   while :
   do
@@ -134,8 +319,36 @@ fi
 #------------------------------------------------------------------------------
 
 
+# Sets up the out of tree build folder, named after the defconfig unless one was given
+if [[ ${outOfTree} == 'yes' ]]; then
+  if [[ -z ${buildDirectory} ]]; then
+    if [[ ${useConfig} == '.config' ]]; then
+      printf "\n\nError, an existing .config can only be built out of tree with '--output DIR'\n"
+      exit 1
+    fi
+    buildDirectory="build/${useConfig%_defconfig}"
+  fi
+
+  mkdir -p "$buildDirectory"
+  buildDirectory=$(cd "$buildDirectory" && pwd)
+  printf "Building out of tree in: ${buildDirectory}\n"
+  makeOutput=(O=$buildDirectory)
+
+  # The bootwrapper looks for the ramdisk next to the objects, not in the sources
+  if [[ ! -f "${buildDirectory}/arch/powerpc/boot/ramdisk.image.gz" && -f 'arch/powerpc/boot/ramdisk.image.gz' ]]; then
+    printf "Copying arch/powerpc/boot/ramdisk.image.gz into the build folder...\n"
+    mkdir -p "${buildDirectory}/arch/powerpc/boot"
+    cp arch/powerpc/boot/ramdisk.image.gz "${buildDirectory}/arch/powerpc/boot/"
+  fi
+else
+  buildDirectory='.'
+  makeOutput=()
+fi
+#------------------------------------------------------------------------------
+
+
 # Sets firmware folder path
-FMW_DIRECTORY='lib/firmware'
+FMW_DIRECTORY="${buildDirectory}/lib/firmware"
 
 # Removes the firmware directory if it already exist
 if [[ -d "$FMW_DIRECTORY" ]]; then
@@ -145,11 +358,11 @@ fi
 
 #Creates the firmware directory
 echo "Creating firmware folder / adding contents into:" $FMW_DIRECTORY
-mkdir $FMW_DIRECTORY
+mkdir -p $FMW_DIRECTORY
 
 
 # Sets the headers folder path
-HDR_DIRECTORY='usr/lib'
+HDR_DIRECTORY="${buildDirectory}/usr/lib"
 
 # Removes the headers directory if it already exist
 if [[ -d "$HDR_DIRECTORY" ]]; then
@@ -159,147 +372,425 @@ fi
 
 #Creates the headers directory
 echo "Creating headers folder / adding contents into:" $HDR_DIRECTORY
-mkdir $HDR_DIRECTORY
+mkdir -p $HDR_DIRECTORY
 #------------------------------------------------------------------------------
 
 
+# Selects the compiler, the make variables for it are collected in makeFlags
+makeFlags=()
+
 if [[ ${MACHINE_TYPE} == 'ppc' ]]; then
-  printf "\n\nCross compiler not needed...\n"
-  if [[ ${useConfig} != '.config' ]]; then
-    make ${useConfig}
+  if [[ ${useCompiler} == 'bundled' ]]; then
+    printf "\n\nError, the included Buildroot cross compiler only runs on x86 hosts\n"
+    exit 1
+  elif [[ -z ${useCompiler} ]]; then
+    printf "\n\nCross compiler not needed...\n"
+    useCompiler='native'
   fi
-  make menuconfig
-  make clean
-  if [[ -f 'arch/powerpc/boot/ramdisk.image.gz' ]]; then
-    printf "Ramdisk found, building zImage.initrd...\n"
-    make zImage.initrd -j${numProcessors}
-    make firmware_install headers_install -j${numProcessors} INSTALL_FW_PATH=$FMW_DIRECTORY INSTALL_HDR_PATH=$HDR_DIRECTORY 
-  else
-    printf "No ramdisk found, building zImage...\n"
-    make zImage -j${numProcessors}
-    make firmware_install headers_install -j${numProcessors} INSTALL_FW_PATH=$FMW_DIRECTORY INSTALL_HDR_PATH=$HDR_DIRECTORY 
-  fi
-  printf "\nNote: If this is the target machine, it should be possible to install everything with 'sudo make install'."
 
-elif [[ ${MACHINE_TYPE} == 'x86_32' || ${MACHINE_TYPE} == 'x86_64' ]]; then
-  while : # Gets the user to select a cross compiler to use
+elif [[ ${MACHINE_TYPE} == 'x86_32' || ${MACHINE_TYPE} == i?86 || ${MACHINE_TYPE} == 'x86_64' ]]; then
+  while [[ -z ${useCompiler} ]] # Gets the user to select a cross compiler to use
   do
     printf "\n\nSelect a cross compiler to use:"
     printf "(Selecting a quit option at any menu will exit this script)\n"
     printf "1) Included gcLinux 2009 Buildroot cross compiler (depreciated)\n"
     printf "2) External OS provided PPC cross compiler (requires gcc-powerpc-linux-gnu)\n"
-    printf "3) Quit script (Alternatives: http://www.gc-linux.org/wiki/Cross-compiling)\n"
+    printf "3) Modern uClibc-ng cross compiler (made with build-ppc-toolchain.sh)\n"
+    printf "4) Quit script (Alternatives: http://www.gc-linux.org/wiki/Cross-compiling)\n"
     echo -n "Response: "
     read opt3
     case $opt3 in
-
-      1) printf "\n\nSelecting gcLinux Buildroot cross compiler\n"
-        if [[ ${MACHINE_TYPE} == 'x86_32' ]]; then
-          export LD_LIBRARY_PATH=H-i686-pc-linux-gnu/cross-powerpc-linux-uclibc/usr/lib
-
-          if [[ ${useConfig} != '.config' ]]; then
-            make ${useConfig} ARCH=powerpc CROSS_COMPILE=H-i686-pc-linux-gnu/cross-powerpc-linux-uclibc/usr/bin/powerpc-linux-
-          fi
-
-          make menuconfig ARCH=powerpc CROSS_COMPILE=H-i686-pc-linux-gnu/cross-powerpc-linux-uclibc/usr/bin/powerpc-linux-
-          make clean ARCH=powerpc CROSS_COMPILE=H-i686-pc-linux-gnu/cross-powerpc-linux-uclibc/usr/bin/powerpc-linux-
-          if [[ -f 'arch/powerpc/boot/ramdisk.image.gz' ]]; then
-            printf "Ramdisk found, building zImage.initrd...\n"
-            make zImage.initrd -j${numProcessors} ARCH=powerpc CROSS_COMPILE=H-i686-pc-linux-gnu/cross-powerpc-linux-uclibc/usr/bin/powerpc-linux-
-            make firmware_install headers_install -j${numProcessors} INSTALL_FW_PATH=$FMW_DIRECTORY INSTALL_HDR_PATH=$HDR_DIRECTORY ARCH=powerpc CROSS_COMPILE=H-i686-pc-linux-gnu/cross-powerpc-linux-uclibc/usr/bin/powerpc-linux-
-          else
-            printf "No ramdisk found, building zImage...\n"
-            make zImage -j${numProcessors} ARCH=powerpc CROSS_COMPILE=H-i686-pc-linux-gnu/cross-powerpc-linux-uclibc/usr/bin/powerpc-linux-
-            make firmware_install headers_install -j${numProcessors} INSTALL_FW_PATH=$FMW_DIRECTORY INSTALL_HDR_PATH=$HDR_DIRECTORY ARCH=powerpc CROSS_COMPILE=H-i686-pc-linux-gnu/cross-powerpc-linux-uclibc/usr/bin/powerpc-linux-
-          fi
-        elif [[ ${MACHINE_TYPE} == 'x86_64' ]]; then
-          export LD_LIBRARY_PATH=H-x86_64-pc-linux-gnu/cross-powerpc-linux-uclibc/usr/lib
-
-          if [[ ${useConfig} != '.config' ]]; then
-            make ${useConfig} ARCH=powerpc CROSS_COMPILE=H-x86_64-pc-linux-gnu/cross-powerpc-linux-uclibc/usr/bin/powerpc-linux-
-          fi
-
-          make menuconfig ARCH=powerpc CROSS_COMPILE=H-x86_64-pc-linux-gnu/cross-powerpc-linux-uclibc/usr/bin/powerpc-linux-
-          make clean ARCH=powerpc CROSS_COMPILE=H-x86_64-pc-linux-gnu/cross-powerpc-linux-uclibc/usr/bin/powerpc-linux-
-          if [[ -f 'arch/powerpc/boot/ramdisk.image.gz' ]]; then
-            printf "Ramdisk found, building zImage.initrd...\n"
-            make zImage.initrd -j${numProcessors} ARCH=powerpc CROSS_COMPILE=H-x86_64-pc-linux-gnu/cross-powerpc-linux-uclibc/usr/bin/powerpc-linux-
-            make firmware_install headers_install -j${numProcessors} INSTALL_FW_PATH=$FMW_DIRECTORY INSTALL_HDR_PATH=$HDR_DIRECTORY ARCH=powerpc CROSS_COMPILE=H-x86_64-pc-linux-gnu/cross-powerpc-linux-uclibc/usr/bin/powerpc-linux-
-          else
-            printf "No ramdisk found, building zImage...\n"
-            make zImage -j${numProcessors} ARCH=powerpc CROSS_COMPILE=H-x86_64-pc-linux-gnu/cross-powerpc-linux-uclibc/usr/bin/powerpc-linux-
-            make firmware_install headers_install INSTALL_FW_PATH=$FMW_DIRECTORY INSTALL_HDR_PATH=$HDR_DIRECTORY ARCH=powerpc CROSS_COMPILE=H-x86_64-pc-linux-gnu/cross-powerpc-linux-uclibc/usr/bin/powerpc-linux-
-          fi
-        fi         
+      1) useCompiler='bundled'
         break;;
 
-      2) printf "\n\nSelecting OS cross compiler\n"
-        if [[ ${useConfig} != '.config' ]]; then
-          make ${useConfig} ARCH=powerpc GCC_HOST=powerpc-linux-gnu- CROSS_COMPILE=powerpc-linux-gnu- CC="ccache powerpc-linux-gnu-gcc"
-        fi
+      2) useCompiler='os'
+        break;;
 
-        make menuconfig ARCH=powerpc GCC_HOST=powerpc-linux-gnu- CROSS_COMPILE=powerpc-linux-gnu- CC="ccache powerpc-linux-gnu-gcc"
-        make clean ARCH=powerpc GCC_HOST=powerpc-linux-gnu- CROSS_COMPILE=powerpc-linux-gnu- CC="ccache powerpc-linux-gnu-gcc"
-        if [[ -f 'arch/powerpc/boot/ramdisk.image.gz' ]]; then
-          printf "Ramdisk found, building zImage.initrd...\n"
-          make zImage.initrd -j${numProcessors} ARCH=powerpc GCC_HOST=powerpc-linux-gnu- CROSS_COMPILE=powerpc-linux-gnu- CC="ccache powerpc-linux-gnu-gcc"
-          make firmware_install headers_install -j${numProcessors} INSTALL_FW_PATH=$FMW_DIRECTORY INSTALL_HDR_PATH=$HDR_DIRECTORY ARCH=powerpc GCC_HOST=powerpc-linux-gnu- CROSS_COMPILE=powerpc-linux-gnu- CC="ccache powerpc-linux-gnu-gcc"
-        else
-          printf "No ramdisk found, building zImage...\n"
-          make zImage -j${numProcessors} ARCH=powerpc GCC_HOST=powerpc-linux-gnu- CROSS_COMPILE=powerpc-linux-gnu- CC="ccache powerpc-linux-gnu-gcc"
-          make firmware_install headers_install -j${numProcessors} INSTALL_FW_PATH=$FMW_DIRECTORY INSTALL_HDR_PATH=$HDR_DIRECTORY ARCH=powerpc GCC_HOST=powerpc-linux-gnu- CROSS_COMPILE=powerpc-linux-gnu- CC="ccache powerpc-linux-gnu-gcc"
-        fi
+      3) useCompiler='modern'
         break;;
 
-      3) printf "\n\nQuitting script...\n"
+      4) printf "\n\nQuitting script...\n"
         exit 0;;
 
       *) printf "\n\n$opt is an invalid option.\n"
-        printf "Please select an option from 1-3 only\n"
+        printf "Please select an option from 1-4 only\n"
         printf "Press [enter] key to continue...\n"
         read enterKey
         ;;
     esac
   done
-  
+
 else # !ppc && !x86_32 && !x86_64
-  while : # Gets the user to verify the cross compiler to use
+  if [[ ${useCompiler} == 'bundled' ]]; then
+    printf "\n\nError, the included Buildroot cross compiler only runs on x86 hosts\n"
+    exit 1
+  fi
+
+  while [[ -z ${useCompiler} ]] # Gets the user to verify the cross compiler to use
   do
     printf "\n\nSelect a cross compiler to use:\n"
     printf "(Selecting a quit option at any menu will exit this script)\n"
     printf "1) External OS provided PowerPC cross compiler (requires gcc-powerpc-linux-gnu)\n"
-    printf "2) Quit script (Alternatives: http://www.gc-linux.org/wiki/Cross-compiling)\n"
+    printf "2) Modern uClibc-ng cross compiler (made with build-ppc-toolchain.sh)\n"
+    printf "3) Quit script (Alternatives: http://www.gc-linux.org/wiki/Cross-compiling)\n"
     echo -n "Response: "
     read opt4
     case $opt4 in
-      1) printf "\n\nSelecting OS cross compiler\n"
-        if [[ ${useConfig} != '.config' ]]; then
-          make ${useConfig} ARCH=powerpc GCC_HOST=powerpc-linux-gnu- CROSS_COMPILE=powerpc-linux-gnu- CC="ccache powerpc-linux-gnu-gcc"
-        fi
+      1) useCompiler='os'
+        break;;
 
-        make menuconfig ARCH=powerpc GCC_HOST=powerpc-linux-gnu- CROSS_COMPILE=powerpc-linux-gnu- CC="ccache powerpc-linux-gnu-gcc"
-        make clean ARCH=powerpc GCC_HOST=powerpc-linux-gnu- CROSS_COMPILE=powerpc-linux-gnu- CC="ccache powerpc-linux-gnu-gcc"
-        if [[ -f 'arch/powerpc/boot/ramdisk.image.gz' ]]; then
-          printf "Ramdisk found, building zImage.initrd...\n"
-          make zImage.initrd -j${numProcessors} ARCH=powerpc GCC_HOST=powerpc-linux-gnu- CROSS_COMPILE=powerpc-linux-gnu- CC="ccache powerpc-linux-gnu-gcc"
-          make firmware_install headers_install -j${numProcessors} INSTALL_FW_PATH=$FMW_DIRECTORY INSTALL_HDR_PATH=$HDR_DIRECTORY ARCH=powerpc GCC_HOST=powerpc-linux-gnu- CROSS_COMPILE=powerpc-linux-gnu- CC="ccache powerpc-linux-gnu-gcc"
-        else
-          printf "No ramdisk found, building zImage...\n"
-          make zImage -j${numProcessors} ARCH=powerpc GCC_HOST=powerpc-linux-gnu- CROSS_COMPILE=powerpc-linux-gnu- CC="ccache powerpc-linux-gnu-gcc"
-          make firmware_install headers_install -j${numProcessors} INSTALL_FW_PATH=$FMW_DIRECTORY INSTALL_HDR_PATH=$HDR_DIRECTORY ARCH=powerpc GCC_HOST=powerpc-linux-gnu- CROSS_COMPILE=powerpc-linux-gnu- CC="ccache powerpc-linux-gnu-gcc"
-        fi
+      2) useCompiler='modern'
         break;;
 
-      2) printf "\n\nQuitting script...\n"
+      3) printf "\n\nQuitting script...\n"
          exit 0;;
 
       *) printf "\n\n$opt is an invalid option.\n"
-         printf "Please select an option from 1-2 only\n"
+         printf "Please select an option from 1-3 only\n"
          printf "Press [enter] key to continue...\n"
          read enterKey
          ;;
     esac
-  done    
+  done
+fi
+
+if [[ ${useCompiler} == 'bundled' ]]; then
+  printf "\n\nSelecting gcLinux Buildroot cross compiler\n"
+  if [[ ${MACHINE_TYPE} == 'x86_64' ]]; then
+    TOOLCHAIN_DIRECTORY='H-x86_64-pc-linux-gnu/cross-powerpc-linux-uclibc'
+  else
+    TOOLCHAIN_DIRECTORY='H-i686-pc-linux-gnu/cross-powerpc-linux-uclibc'
+  fi
+  # Absolute, since out of tree builds run make from inside the build folder
+  TOOLCHAIN_DIRECTORY="${PWD}/${TOOLCHAIN_DIRECTORY}"
+  export LD_LIBRARY_PATH=$TOOLCHAIN_DIRECTORY/usr/lib
+  crossPrefix="$TOOLCHAIN_DIRECTORY/usr/bin/powerpc-linux-"
+  makeFlags=(ARCH=powerpc CROSS_COMPILE=$crossPrefix)
+  compilerDriver="${crossPrefix}gcc"
+
+elif [[ ${useCompiler} == 'modern' ]]; then
+  printf "\n\nSelecting modern uClibc-ng cross compiler\n"
+  TOOLCHAIN_DIRECTORY="${PWD}/H-$(uname -m)-pc-linux-gnu/cross-powerpc-linux-uclibc-ng"
+  if [[ ! -x $TOOLCHAIN_DIRECTORY/usr/bin/powerpc-linux-gcc ]]; then
+    printf "Error, no toolchain in $TOOLCHAIN_DIRECTORY\n"
+    printf "Build it first with: ./build-ppc-toolchain.sh\n"
+    exit 1
+  fi
+  crossPrefix="$TOOLCHAIN_DIRECTORY/usr/bin/powerpc-linux-"
+  makeFlags=(ARCH=powerpc CROSS_COMPILE=$crossPrefix)
+  compilerDriver="${crossPrefix}gcc"
+
+elif [[ ${useCompiler} == 'os' ]]; then
+  printf "\n\nSelecting OS cross compiler\n"
+  crossPrefix='powerpc-linux-gnu-'
+  makeFlags=(ARCH=powerpc GCC_HOST=$crossPrefix CROSS_COMPILE=$crossPrefix)
+  compilerDriver="${crossPrefix}gcc"
+
+else
+  crossPrefix=''
+  compilerDriver='gcc'
+fi
+#------------------------------------------------------------------------------
+
+
+# Wraps whichever compiler was selected in ccache and/or distcc / icecc
+compilerLauncher=''
+
+if [[ -n ${useDistributed} ]] && ! type ${useDistributed} > /dev/null 2>&1; then
+  printf "\n\n${useDistributed} not found, compiling on this host only...\n"
+  useDistributed=''
+fi
+
+if [[ ${useCcache} == 'yes' ]] && ! type ccache > /dev/null 2>&1; then
+  printf "\n\nccache not found, building without a compiler cache...\n"
+  useCcache='no'
+fi
+
+if [[ ${useCcache} == 'yes' ]]; then
+  compilerLauncher='ccache'
+  # Lets the per variant build folders and other checkouts share cache hits
+  export CCACHE_BASEDIR=${CCACHE_BASEDIR:-$PWD}
+  if [[ -n ${useDistributed} ]]; then
+    export CCACHE_PREFIX=${useDistributed}
+  fi
+elif [[ -n ${useDistributed} ]]; then
+  compilerLauncher=${useDistributed}
+fi
+
+compilerCommand="${compilerLauncher:+${compilerLauncher} }${compilerDriver}"
+
+# Build profiling puts a small wrapper in front of the compiler that logs
+# when each object started and finished compiling (kbuild compiles to
+# .tmp_NAME.o first with CONFIG_MODVERSIONS, those are logged as NAME.o)
+if [[ ${profileBuild} == 'yes' ]]; then
+  PROFILE_DIRECTORY="$(cd ${buildDirectory} && pwd)/build-profile"
+  mkdir -p $PROFILE_DIRECTORY
+  rm -f $PROFILE_DIRECTORY/compile.log
+  cat > $PROFILE_DIRECTORY/cc-wrapper <<EOF
+#!/bin/bash
+# Generated by build-gc-wii-kernel.sh --profile-build
+start=\$(date +%s%N)
+"\$@"
+status=\$?
+end=\$(date +%s%N)
+while [[ \$# -gt 1 && \$1 != '-o' ]]; do
+  shift
+done
+if [[ \$1 == '-o' && \$2 == *.o ]]; then
+  object=\${2#./}
+  object=\${object//\/.tmp_//}
+  echo "\${start} \${end} \${object#.tmp_}" >> $PROFILE_DIRECTORY/compile.log
+fi
+exit \${status}
+EOF
+  chmod +x $PROFILE_DIRECTORY/cc-wrapper
+  compilerCommand="$PROFILE_DIRECTORY/cc-wrapper ${compilerCommand}"
+fi
+
+if [[ ${compilerCommand} != ${compilerDriver} ]]; then
+  printf "Compiling with: ${compilerCommand}${CCACHE_PREFIX:+ (through ${CCACHE_PREFIX})}\n"
+  makeFlags+=(CC="${compilerCommand}")
+fi
+
+# Prints the ccache hit and miss counters as "hits misses" (newer ccache
+# releases have --print-stats, older ones only the human readable -s)
+ccacheCounters()
+{
+  local counters
+  counters=$(ccache --print-stats 2> /dev/null | awk '$1 ~ /^(direct|preprocessed)_cache_hit$/ { hits += $2 }
+    $1 == "cache_miss" { misses += $2; found = 1 } END { if (found) print hits + 0, misses + 0 }')
+  if [[ -z ${counters} ]]; then
+    counters=$(ccache -s | awk '/^cache hit/ { hits += $NF } /^cache miss/ { misses += $NF } END { print hits + 0, misses + 0 }')
+  fi
+  echo ${counters}
+}
+
+if [[ ${useCcache} == 'yes' ]]; then
+  ccacheBefore=($(ccacheCounters))
+fi
+#------------------------------------------------------------------------------
+
+
+# Configures and builds the kernel with the selected compiler
+makeFlags+=("${makeOutput[@]}")
+
+if [[ ${useConfig} != '.config' ]]; then
+  make ${useConfig} "${makeFlags[@]}"
+fi
+
+if [[ ${incrementalBuild} == 'yes' ]]; then
+  printf "\n\nIncremental build, skipping menuconfig and clean...\n"
+else
+  make menuconfig "${makeFlags[@]}"
+  make clean "${makeFlags[@]}"
+fi
+
+if [[ -f "${buildDirectory}/arch/powerpc/boot/ramdisk.image.gz" ]]; then
+  printf "Ramdisk found, building zImage.initrd...\n"
+  buildImage='zImage.initrd'
+else
+  printf "No ramdisk found, building zImage...\n"
+  buildImage='zImage'
+fi
+
+# A failed build has to stop here, otherwise an incremental build would
+# happily pick up the zImage left over from the previous run
+if ! make ${buildImage} -j${numProcessors} "${makeFlags[@]}"; then
+  printf "\nError, building ${buildImage} failed!\n"
+  printf "Check above for errors\n"
+  printf "Quitting script...\n"
+  exit 1
+fi
+make firmware_install headers_install -j${numProcessors} INSTALL_FW_PATH=$(cd $FMW_DIRECTORY && pwd) INSTALL_HDR_PATH=$(cd $HDR_DIRECTORY && pwd) "${makeFlags[@]}"
+
+if [[ ${useCompiler} == 'native' ]]; then
+  printf "\nNote: If this is the target machine, it should be possible to install everything with 'sudo make install'."
+fi
+#------------------------------------------------------------------------------
+
+
+# Initramfs assembly: the modules (stripped), firmware and optionally headers
+# are staged as a root tree and packed with the kernel's own gen_init_cpio,
+# sorted and with fixed owners and times so the same inputs give the same
+# archive.  The kernel unpacks concatenated cpio archives, so this is appended
+# to the base ramdisk instead of unpacking it (which would need root for the
+# device nodes).  Nothing is repacked or rewrapped when the content is unchanged.
+if [[ ${buildInitramfs} == 'yes' ]]; then
+  printf "\n\n- Initramfs -\n"
+  INITRAMFS_DIRECTORY="$(cd ${buildDirectory} && pwd)/initramfs"
+  BOOT_DIRECTORY="${buildDirectory}/arch/powerpc/boot"
+  stageDirectory=$INITRAMFS_DIRECTORY/root
+  stripCache=$INITRAMFS_DIRECTORY/strip-cache
+  rm -rf $stageDirectory
+  mkdir -p $stageDirectory $stripCache
+  # "content hash" and "ramdisk hash" of the last run
+  lastHashes=($(cat $INITRAMFS_DIRECTORY/hashes 2> /dev/null))
+
+  if [[ -n ${initramfsBase} ]]; then
+    printf "Using the root filesystem in: ${initramfsBase}\n"
+    cp -a ${initramfsBase}/. $stageDirectory/
+    rm -f $INITRAMFS_DIRECTORY/base.cpio.gz
+  elif [[ -f $BOOT_DIRECTORY/ramdisk.image.gz && $(sha256sum < $BOOT_DIRECTORY/ramdisk.image.gz | cut -d' ' -f1) != ${lastHashes[1]} ]]; then
+    # A ramdisk this stage didn't write is (a new) base, but only a cpio can be appended to
+    case $(gzip -dc $BOOT_DIRECTORY/ramdisk.image.gz 2> /dev/null | head -c 6) in
+      070701|070702) printf "Using arch/powerpc/boot/ramdisk.image.gz as the base of the initramfs\n"
+        cp -p $BOOT_DIRECTORY/ramdisk.image.gz $INITRAMFS_DIRECTORY/base.cpio.gz;;
+      *) printf "Error, ramdisk.image.gz isn't a gzip compressed cpio archive (initramfs)\n"
+        printf "Use '--initramfs-base DIR' with the root filesystem of the ramdisk instead\n"
+        printf "Quitting script...\n"
+        exit 1;;
+    esac
+  elif [[ ! -f $INITRAMFS_DIRECTORY/base.cpio.gz ]]; then
+    printf "Warning, no base ramdisk or '--initramfs-base', the initramfs will have no /init\n"
+  fi
+
+  if grep -q '^CONFIG_MODULES=y' ${buildDirectory}/.config; then
+    make modules -j${numProcessors} "${makeFlags[@]}" || exit 1
+    make modules_install -j${numProcessors} INSTALL_MOD_PATH=$stageDirectory "${makeFlags[@]}" > /dev/null || exit 1
+    # The build and source links point into this host's checkout, which
+    # the console doesn't have (and would tie the archive to this path)
+    rm -f $stageDirectory/lib/modules/*/build $stageDirectory/lib/modules/*/source
+
+    # Modules are stripped once per content (sha256 of the unstripped module)
+    # into the cache, with as many strip processes as make jobs
+    find $stageDirectory/lib/modules -name '*.ko' -print0 | xargs -0 -r sha256sum > $INITRAMFS_DIRECTORY/modules.sha256
+    while read moduleHash modulePath; do
+      if [[ ! -f $stripCache/$moduleHash.ko ]]; then
+        echo $moduleHash $modulePath
+      fi
+    done < $INITRAMFS_DIRECTORY/modules.sha256 > $INITRAMFS_DIRECTORY/modules.new
+    printf "Modules: $(wc -l < $INITRAMFS_DIRECTORY/modules.sha256) installed, $(wc -l < $INITRAMFS_DIRECTORY/modules.new) new or changed to strip\n"
+    if ! STRIP_CACHE=$stripCache xargs -r -P ${numProcessors} -L 1 bash -c '"$0" --strip-debug -o "$STRIP_CACHE/$1.ko.tmp" "$2" && mv "$STRIP_CACHE/$1.ko.tmp" "$STRIP_CACHE/$1.ko"' ${crossPrefix}strip < $INITRAMFS_DIRECTORY/modules.new; then
+      rm -f $stripCache/*.ko.tmp
+      printf "Error, stripping the modules failed!\n"
+      printf "Quitting script...\n"
+      exit 1
+    fi
+    while read moduleHash modulePath; do
+      cp $stripCache/$moduleHash.ko $modulePath
+    done < $INITRAMFS_DIRECTORY/modules.sha256
+
+    # Drops cache entries of modules that are gone
+    find $stripCache -name '*.ko' | while read cachedModule; do
+      if ! grep -q "^$(basename $cachedModule .ko) " $INITRAMFS_DIRECTORY/modules.sha256; then
+        rm -f $cachedModule
+      fi
+    done
+    rm -f $INITRAMFS_DIRECTORY/modules.new
+  fi
+
+  mkdir -p $stageDirectory/lib/firmware
+  cp -a $FMW_DIRECTORY/. $stageDirectory/lib/firmware/
+  if [[ ${initramfsHeaders} == 'yes' ]]; then
+    mkdir -p $stageDirectory/usr
+    cp -a $HDR_DIRECTORY/include $stageDirectory/usr/
+  fi
+
+  contentHash=$( (
+    cd $stageDirectory
+    find . -printf '%p %m %l\n' | LC_ALL=C sort
+    find . -type f -print0 | LC_ALL=C sort -z | xargs -0 -r sha256sum
+    cat $INITRAMFS_DIRECTORY/base.cpio.gz 2> /dev/null
+  ) | sha256sum | cut -d' ' -f1)
+
+  if [[ ${contentHash} == ${lastHashes[0]} && -f $BOOT_DIRECTORY/ramdisk.image.gz && -f $BOOT_DIRECTORY/zImage.initrd ]]; then
+    printf "Initramfs content unchanged, keeping the current ramdisk.image.gz and zImage.initrd\n"
+  else
+    if [[ ! -x ${buildDirectory}/usr/gen_init_cpio ]]; then
+      make usr/gen_init_cpio "${makeFlags[@]}" > /dev/null || exit 1
+    fi
+    cpioFlags=()
+    if ${buildDirectory}/usr/gen_init_cpio 2>&1 | grep -q -- '-t <timestamp>'; then
+      cpioFlags=(-t ${SOURCE_DATE_EPOCH:-0})
+    fi
+    find $stageDirectory -exec touch -h -d @${SOURCE_DATE_EPOCH:-0} {} +
+
+    # Sorting by path keeps every folder ahead of its contents
+    bash scripts/gen_initramfs_list.sh -u squash -g squash $stageDirectory | grep -v '^#' | LC_ALL=C sort -k 2,2 > $INITRAMFS_DIRECTORY/initramfs.list
+    ${buildDirectory}/usr/gen_init_cpio "${cpioFlags[@]}" $INITRAMFS_DIRECTORY/initramfs.list | gzip -n -9 > $INITRAMFS_DIRECTORY/extra.cpio.gz || exit 1
+    cat $INITRAMFS_DIRECTORY/base.cpio.gz $INITRAMFS_DIRECTORY/extra.cpio.gz 2> /dev/null > $BOOT_DIRECTORY/ramdisk.image.gz
+    printf "Wrote ramdisk.image.gz ($(( $(stat -c %s $BOOT_DIRECTORY/ramdisk.image.gz) / 1024 )) KB)\n"
+
+    # The wrapper doesn't depend on the ramdisk, so the old images have to go
+    rm -f $BOOT_DIRECTORY/zImage.initrd*
+    if ! make zImage.initrd "${makeFlags[@]}"; then
+      printf "\nError, building zImage.initrd failed!\n"
+      printf "Quitting script...\n"
+      exit 1
+    fi
+    echo ${contentHash} $(sha256sum < $BOOT_DIRECTORY/ramdisk.image.gz | cut -d' ' -f1) > $INITRAMFS_DIRECTORY/hashes
+  fi
+  buildImage='zImage.initrd'
+fi
+
+# The counters are shared by every ccache user, so builds running at the
+# same time (or other projects) also show up in these numbers
+if [[ ${useCcache} == 'yes' ]]; then
+  ccacheAfter=($(ccacheCounters))
+  ccacheHits=$(( ${ccacheAfter[0]:-0} - ${ccacheBefore[0]:-0} ))
+  ccacheMisses=$(( ${ccacheAfter[1]:-0} - ${ccacheBefore[1]:-0} ))
+  if (( ccacheHits + ccacheMisses > 0 )); then
+    ccacheSummary="${ccacheHits} hits, ${ccacheMisses} misses ($(( 100 * ccacheHits / (ccacheHits + ccacheMisses) ))% hit rate)"
+  else
+    ccacheSummary='nothing was compiled'
+  fi
+fi
+#------------------------------------------------------------------------------
+
+
+# Turns the compile log into the per directory report and the Chrome trace
+if [[ ${profileBuild} == 'yes' ]]; then
+  if [[ -s $PROFILE_DIRECTORY/compile.log ]]; then
+    sort -n $PROFILE_DIRECTORY/compile.log | awk -v report=$PROFILE_DIRECTORY/report.txt -v trace=$PROFILE_DIRECTORY/trace.json '
+      {
+        start[NR] = $1; end[NR] = $2; object[NR] = $3
+        seconds = ($2 - $1) / 1e9
+        total += seconds
+        if (NR == 1) first = $1
+        if ($2 > last) last = $2
+
+        directory = $3; sub(/\/[^\/]*$/, "", directory)
+        if (directory == $3) directory = "."
+        top = directory; sub(/\/.*$/, "", top)
+        dirTime[directory] += seconds; dirCount[directory]++
+        topTime[top] += seconds; topCount[top]++
+        objTime[$3] = seconds
+      }
+      # The rows go out unsorted behind their exact time, sort puts the slowest first
+      function table(title, times, counts, limit,    key, sorter) {
+        printf "\n%s\n%10s %7s %6s  %s\n", title, "seconds", "share", "files", "path" >> report
+        close(report)
+        sorter = "sort -k 1,1nr | cut -d \" \" -f 2- | head -n " limit " >> " report
+        for (key in times)
+          printf "%.9f %10.2f %6.1f%% %6s  %s\n", times[key], times[key], 100 * times[key] / total, (key in counts) ? counts[key] : 1, key | sorter
+        close(sorter)
+      }
+      END {
+        printf "Compiled %d objects, %.1f s of compiler time in %.1f s of wall time\n", NR, total, (last - first) / 1e9 > report
+        close(report)
+        table("By top level directory:", topTime, topCount, 1000)
+        table("By directory (slowest 40):", dirTime, dirCount, 40)
+        table("Slowest objects:", objTime, none, 25)
+
+        # Packs the compiles into as few rows as needed, so parallel jobs
+        # show up side by side with one row per busy make job
+        printf "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n" > trace
+        lanes = 0
+        for (i = 1; i <= NR; i++) {
+          for (lane = 1; lane <= lanes && laneEnd[lane] > start[i]; lane++) ;
+          if (lane > lanes) lanes = lane
+          laneEnd[lane] = end[i]
+          category = object[i]; sub(/\/.*$/, "", category)
+          printf "%s{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}", (i > 1) ? ",\n" : "", object[i], category, lane, (start[i] - first) / 1e3, (end[i] - start[i]) / 1e3 > trace
+        }
+        printf "\n]}\n" > trace
+      }'
+    printf "\n\n- Build Profile -\n"
+    awk '/^By directory/ { exit } { print }' $PROFILE_DIRECTORY/report.txt
+    printf "(Full report: $PROFILE_DIRECTORY/report.txt, trace: $PROFILE_DIRECTORY/trace.json)\n"
+  else
+    printf "\n\nBuild profile: nothing was compiled\n"
+  fi
 fi
 #------------------------------------------------------------------------------
 
@@ -308,20 +799,663 @@ fi
 zImageFile=''
 
 # Checks for a zImage/zImage.initrd binary and if none exist, build was likely unsuccessful
-if [[ -f 'arch/powerpc/boot/zImage' ]]; then
-  printf "zImage found...\n"
-  zImageFile='arch/powerpc/boot/zImage'
-elif [[ -f 'arch/powerpc/boot/zImage.initrd' ]]; then
-  printf "zImage.initrd found...\n"
-  zImageFile='arch/powerpc/boot/zImage.initrd'
+if [[ -f "${buildDirectory}/arch/powerpc/boot/${buildImage}" ]]; then
+  printf "${buildImage} found...\n"
+  zImageFile="${buildDirectory}/arch/powerpc/boot/${buildImage}"
 else # No zImage/zImage.intrid (was likely an unsuccessful build)
   printf "Error, zImage (Kernel) not found!\n"
   printf "Check above for errors as this was likely an unsuccessful build\n"
   printf "Quitting script...\n"
   exit 1
 fi
+#------------------------------------------------------------------------------
+
+
+# Size report: text/data/bss of vmlinux and of each built-in subsystem, and a
+# bloat-o-meter style per symbol diff against the saved baseline
+if [[ ${sizeReport} == 'yes' ]]; then
+  SIZE_DIRECTORY="${buildDirectory}/size-report"
+  mkdir -p $SIZE_DIRECTORY
+  rm -f $SIZE_DIRECTORY/diff.txt
+  printf "\n\n- Kernel Size Report -\n"
+
+  # Top level subsystems, the arch/powerpc parts and the big directories one level down
+  (
+    cd ${buildDirectory}
+    ${crossPrefix}size vmlinux */built-in.o arch/powerpc/*/built-in.o drivers/*/built-in.o fs/*/built-in.o net/*/built-in.o sound/*/built-in.o 2> /dev/null
+  ) | awk -v report=$SIZE_DIRECTORY/report.txt '
+    NR == 1 { next }
+    {
+      path = $6; sub(/\/built-in\.o$/, "", path)
+      text[path] = $1; data[path] = $2; bss[path] = $3; total[path] = $4
+      if (path == "vmlinux") next
+      if (path ~ /^(arch\/powerpc|drivers|fs|net|sound)\//) deep[++nDeep] = path
+      else top[++nTop] = path
+    }
+    # The rows go out unsorted, sort puts the largest first
+    function table(title, list, n, limit,    i, sorter) {
+      printf "\n%s\n%10s %10s %10s %10s %6s  %s\n", title, "text", "data", "bss", "total", "share", "path" >> report
+      close(report)
+      sorter = "sort -k 4,4nr | head -n " limit " >> " report
+      for (i = 1; i <= n; i++)
+        printf "%10d %10d %10d %10d %5.1f%%  %s\n", text[list[i]], data[list[i]], bss[list[i]], total[list[i]], (total["vmlinux"] > 0) ? 100 * total[list[i]] / total["vmlinux"] : 0, list[i] | sorter
+      close(sorter)
+    }
+    END {
+      printf "vmlinux: text %d, data %d, bss %d, total %d bytes (%d KB)\n", text["vmlinux"], data["vmlinux"], bss["vmlinux"], total["vmlinux"], total["vmlinux"] / 1024 > report
+      close(report)
+      table("Built-in subsystems:", top, nTop, 1000)
+      table("Largest directories below arch/powerpc, drivers, fs, net and sound:", deep, nDeep, 30)
+    }'
+  ls -l $zImageFile | awk '{ printf "\n%s: %d bytes (%d KB)\n", $NF, $5, $5 / 1024 }' >> $SIZE_DIRECTORY/report.txt
+
+  # nm lists "address size type name" with the size in hex, statics sharing a name are added up
+  ${crossPrefix}nm --size-sort -S ${buildDirectory}/vmlinux | awk '
+    function hex(digits,    i, value) {
+      value = 0
+      digits = tolower(digits)
+      for (i = 1; i <= length(digits); i++)
+        value = value * 16 + index("0123456789abcdef", substr(digits, i, 1)) - 1
+      return value
+    }
+    { size[$4] += hex($2) }
+    END { for (name in size) print name, size[name] }' | sort > $SIZE_DIRECTORY/vmlinux.symbols
+
+  if [[ -f $SIZE_DIRECTORY/baseline.symbols ]]; then
+    awk '
+      FNR == NR { old[$1] = $2; next }
+      { new[$1] = $2 }
+      END {
+        for (name in old) if (!(name in new)) { delta[name] = -old[name]; removed++ }
+        for (name in new) {
+          if (!(name in old)) { delta[name] = new[name]; added++ }
+          else if (new[name] != old[name]) delta[name] = new[name] - old[name]
+        }
+        for (name in delta) {
+          if (delta[name] > 0) { up += delta[name]; if (name in old) grew++ }
+          else { down -= delta[name]; if (name in new) shrank++ }
+        }
+        printf "add/remove: %d/%d grow/shrink: %d/%d up/down: %d/%d (%d)\n", added, removed, grew, shrank, up, -down, up - down
+        printf "%-40s %10s %10s %10s\n", "function", "old", "new", "delta"
+        fflush()
+
+        # The rows go out unsorted behind their delta, sort puts the largest growth first
+        sorter = "sort -k 1,1nr | cut -d \" \" -f 2-"
+        for (name in delta)
+          printf "%d %-40s %10d %10d %+10d\n", delta[name], name, old[name], new[name], delta[name] | sorter
+        close(sorter)
+      }' $SIZE_DIRECTORY/baseline.symbols $SIZE_DIRECTORY/vmlinux.symbols > $SIZE_DIRECTORY/diff.txt
+  fi
+
+  cat $SIZE_DIRECTORY/report.txt
+  if [[ -f $SIZE_DIRECTORY/diff.txt ]]; then
+    printf "\nChange against the baseline (largest growth first, full list in $SIZE_DIRECTORY/diff.txt):\n"
+    head -n 22 $SIZE_DIRECTORY/diff.txt
+  elif [[ ${saveSizeBaseline} == 'no' ]]; then
+    printf "\nNo size baseline yet, save one with '--save-size-baseline'\n"
+  fi
+
+  if [[ ${saveSizeBaseline} == 'yes' ]]; then
+    cp $SIZE_DIRECTORY/vmlinux.symbols $SIZE_DIRECTORY/baseline.symbols
+    printf "Saved this build as the size baseline\n"
+  fi
+
+  if [[ -n ${sizeBudget} ]]; then
+    vmlinuxKB=$(${crossPrefix}size ${buildDirectory}/vmlinux | awk 'NR == 2 { print int($4 / 1024) }')
+    if (( vmlinuxKB > sizeBudget )); then
+      printf "\nError, vmlinux is ${vmlinuxKB} KB which is over the budget of ${sizeBudget} KB!\n"
+      printf "Quitting script...\n"
+      exit 1
+    fi
+    printf "\nvmlinux is ${vmlinuxKB} KB, within the budget of ${sizeBudget} KB\n"
+  fi
+fi
+#------------------------------------------------------------------------------
+
+
+# Compression benchmark: the bootwrapper of these kernels only knows gzip for
+# vmlinux, but the kernel itself unpacks the ramdisk in any format enabled with
+# CONFIG_RD_*, so zImage.initrd is rebuilt once per available ramdisk format.
+# Decompression is timed with the kernel's own decompressors (lib/decompress_*.c)
+# built into a small program for this host, the way the preboot code builds
+# them, and timed inside that program.  The times are for this host's CPU, the
+# console is a lot slower.
+if [[ ${compressionBenchmark} == 'yes' ]]; then
+  BENCH_DIRECTORY="${buildDirectory}/compression-benchmark"
+  BOOT_DIRECTORY="${buildDirectory}/arch/powerpc/boot"
+  rm -rf $BENCH_DIRECTORY
+  mkdir -p $BENCH_DIRECTORY
+  printf "\n\n- Compression Benchmark -\n"
+
+  # name, compress command, host decompress command, kernel option needed for a
+  # ramdisk, and the kernel's decompressor (source in lib/ and function); the
+  # flags are the ones kbuild packs an initramfs with (usr/Makefile and
+  # scripts/Makefile.lib), so the images are what the kernel's decompressors
+  # expect (xz with a 1 MiB dictionary, "lzma -9" is xz's lzma format and
+  # "lz4 -l -9" is "lz4c -l -c1")
+  compressors=('gzip|gzip -n -f -9|gzip -dc|CONFIG_RD_GZIP|decompress_inflate.c|gunzip'
+               'bzip2|bzip2 -9|bzip2 -dc|CONFIG_RD_BZIP2|decompress_bunzip2.c|bunzip2'
+               'lzma|xz --format=lzma -9|xz --format=lzma -dc|CONFIG_RD_LZMA|decompress_unlzma.c|unlzma'
+               'xz|xz --check=crc32 --lzma2=dict=1MiB|xz -dc|CONFIG_RD_XZ|decompress_unxz.c|unxz'
+               'lzo|lzop -9|lzop -dc|CONFIG_RD_LZO|decompress_unlzo.c|unlzo'
+               'lz4|lz4 -l -9|lz4 -dc|CONFIG_RD_LZ4|decompress_unlz4.c|unlz4')
+
+  # The decompressors are built as in the preboot code (STATIC, with the
+  # simple malloc from linux/decompress/mm.h in a heap of their own), with
+  # just enough of the kernel headers in harness/include to compile them for
+  # this host.  The program unpacks into memory, checks the result once and
+  # prints the fastest of at least 5 runs (and half a second) in microseconds.
+  HARNESS_DIRECTORY="$(cd ${BENCH_DIRECTORY} && pwd)/harness"
+  mkdir -p $HARNESS_DIRECTORY/include/linux $HARNESS_DIRECTORY/include/asm
+  cat > $HARNESS_DIRECTORY/include/harness.h <<'EOF'
+/* Generated by build-gc-wii-kernel.sh --compression-benchmark */
+#ifndef HARNESS_H
+#define HARNESS_H
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef int64_t s64;
+typedef u8 __u8;
+typedef u16 __u16;
+typedef u32 __u32;
+typedef u64 __u64;
+typedef u16 __le16;
+typedef u32 __le32;
+typedef u64 __le64;
+typedef u16 __be16;
+typedef u32 __be32;
+
+#define likely(x) __builtin_expect(!!(x), 1)
+#define unlikely(x) __builtin_expect(!!(x), 0)
+#define noinline __attribute__((noinline))
+#ifndef __always_inline
+#define __always_inline inline __attribute__((always_inline))
+#endif
+#define __init
+#define __initdata
+#define __initconst
+#define __force
+#define uninitialized_var(x) x = x
+#define EXPORT_SYMBOL(x)
+#define EXPORT_SYMBOL_GPL(x)
+#define MODULE_LICENSE(x)
+#define MODULE_DESCRIPTION(x)
+#define MODULE_AUTHOR(x)
+#ifndef min
+#define min(x, y) ((x) < (y) ? (x) : (y))
+#endif
+#ifndef max
+#define max(x, y) ((x) > (y) ? (x) : (y))
+#endif
+#ifndef min_t
+#define min_t(type, x, y) min((type)(x), (type)(y))
+#endif
+#ifndef max_t
+#define max_t(type, x, y) max((type)(x), (type)(y))
+#endif
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define __LITTLE_ENDIAN 1234
+#else
+#define __BIG_ENDIAN 4321
+#endif
+
+#define get_unaligned(ptr) \
+	({ const struct { __typeof__(*(ptr)) __v; } __attribute__((packed)) *__p = (const void *)(ptr); __p->__v; })
+#define put_unaligned(val, ptr) \
+	({ struct { __typeof__(*(ptr)) __v; } __attribute__((packed)) *__p = (void *)(ptr); __p->__v = (val); (void)0; })
+
+static inline u16 get_unaligned_le16(const void *p)
+{
+	const u8 *b = p;
+	return b[0] | b[1] << 8;
+}
+
+static inline u32 get_unaligned_le32(const void *p)
+{
+	const u8 *b = p;
+	return b[0] | b[1] << 8 | b[2] << 16 | (u32)b[3] << 24;
+}
+
+static inline u64 get_unaligned_le64(const void *p)
+{
+	return get_unaligned_le32(p) | (u64)get_unaligned_le32((const u8 *)p + 4) << 32;
+}
+
+static inline u16 get_unaligned_be16(const void *p)
+{
+	const u8 *b = p;
+	return b[0] << 8 | b[1];
+}
+
+static inline u32 get_unaligned_be32(const void *p)
+{
+	const u8 *b = p;
+	return (u32)b[0] << 24 | b[1] << 16 | b[2] << 8 | b[3];
+}
+
+static inline void put_unaligned_le16(u16 val, void *p)
+{
+	u8 *b = p;
+	b[0] = val;
+	b[1] = val >> 8;
+}
+
+static inline void put_unaligned_le32(u32 val, void *p)
+{
+	u8 *b = p;
+	b[0] = val;
+	b[1] = val >> 8;
+	b[2] = val >> 16;
+	b[3] = val >> 24;
+}
+
+static inline void put_unaligned_be32(u32 val, void *p)
+{
+	u8 *b = p;
+	b[0] = val >> 24;
+	b[1] = val >> 16;
+	b[2] = val >> 8;
+	b[3] = val;
+}
+
+static inline u32 le32_to_cpu(u32 val)
+{
+	return get_unaligned_le32(&val);
+}
+
+static inline u32 be32_to_cpu(u32 val)
+{
+	return get_unaligned_be32(&val);
+}
+
+#define le32_to_cpup(p) get_unaligned_le32(p)
+#define be32_to_cpup(p) get_unaligned_be32(p)
+#define cpu_to_le32(val) le32_to_cpu(val)
+#define cpu_to_be32(val) be32_to_cpu(val)
+#endif
+EOF
+  for header in linux/types.h linux/stddef.h linux/compiler.h linux/kernel.h linux/string.h \
+                linux/init.h linux/slab.h linux/vmalloc.h linux/module.h linux/export.h \
+                linux/errno.h linux/bug.h asm/unaligned.h asm/byteorder.h; do
+    echo '#include <harness.h>' > $HARNESS_DIRECTORY/include/$header
+  done
+
+  cat > $HARNESS_DIRECTORY/decompress.c <<'EOF'
+/* Generated by build-gc-wii-kernel.sh --compression-benchmark */
+#define STATIC static
+#include <linux/types.h>
+#include <linux/compiler.h>
+#include <linux/string.h>
+
+static unsigned long free_mem_ptr;
+static unsigned long free_mem_end_ptr;
+
+#include DECOMPRESSOR_SOURCE
+
+int harnessDecompress(unsigned char *in, int inLength, unsigned char *out,
+		      void *heap, unsigned long heapSize, void (*error)(char *x))
+{
+	int position = 0;
+
+	free_mem_ptr = (unsigned long)heap;
+	free_mem_end_ptr = free_mem_ptr + heapSize;
+	malloc_ptr = free_mem_ptr;
+	malloc_count = 0;
+	return DECOMPRESSOR_FUNCTION(in, inLength, NULL, NULL, out, &position, error);
+}
+EOF
 
-while :
+  cat > $HARNESS_DIRECTORY/main.c <<'EOF'
+/* Generated by build-gc-wii-kernel.sh --compression-benchmark */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define HEAP_SIZE (64 << 20)
+
+int harnessDecompress(unsigned char *in, int inLength, unsigned char *out,
+		      void *heap, unsigned long heapSize, void (*error)(char *x));
+
+static int failed;
+
+static void error(char *message)
+{
+	fprintf(stderr, "%s\n", message);
+	failed = 1;
+}
+
+static unsigned char *readFile(const char *path, long *length)
+{
+	FILE *file = fopen(path, "rb");
+	unsigned char *data = NULL;
+
+	if (file && fseek(file, 0, SEEK_END) == 0 && (*length = ftell(file)) >= 0 &&
+	    fseek(file, 0, SEEK_SET) == 0 && (data = malloc(*length + 1)) &&
+	    fread(data, 1, *length, file) != (size_t)*length) {
+		free(data);
+		data = NULL;
+	}
+	if (file)
+		fclose(file);
+	return data;
+}
+
+static double now(void)
+{
+	struct timespec time;
+
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+/* Usage: harness-NAME COMPRESSED RAW */
+int main(int argc, char *argv[])
+{
+	long inLength, rawLength;
+	unsigned char *in, *raw, *out;
+	void *heap;
+	double start, elapsed, fastest = 0, total = 0;
+	int runs;
+
+	if (argc != 3 || !(in = readFile(argv[1], &inLength)) || !(raw = readFile(argv[2], &rawLength))) {
+		fprintf(stderr, "Usage: %s COMPRESSED RAW\n", argv[0]);
+		return 1;
+	}
+	out = malloc(rawLength + 4096);
+	heap = malloc(HEAP_SIZE);
+	if (!out || !heap)
+		return 1;
+
+	for (runs = 0; runs < 5 || total < 0.5; runs++) {
+		start = now();
+		if (harnessDecompress(in, inLength, out, heap, HEAP_SIZE, error) != 0 || failed)
+			return 1;
+		elapsed = now() - start;
+		if (runs == 0 && memcmp(out, raw, rawLength) != 0) {
+			fprintf(stderr, "The output doesn't match the original\n");
+			return 1;
+		}
+		if (runs == 0 || elapsed < fastest)
+			fastest = elapsed;
+		total += elapsed;
+	}
+	printf("%.1f\n", fastest * 1e6);
+	return 0;
+}
+EOF
+
+  # One program per format, a decompressor this kernel doesn't have or that
+  # doesn't build shows up as n/a (the compiler output is in harness/NAME.log)
+  harnessFlags=(-std=gnu89 -O2 -w -fno-strict-aliasing -fno-builtin-malloc -fno-builtin-free
+                -fno-tree-loop-distribute-patterns -U_FORTIFY_SOURCE -D__KERNEL__
+                -I$HARNESS_DIRECTORY/include -I${PWD}/include)
+  harnessBuilt=()
+  for entry in "${compressors[@]}"; do
+    IFS='|' read name compress decompress option source function <<< "$entry"
+    if [[ -f lib/${source} ]] && ${HOSTCC:-gcc} "${harnessFlags[@]}" "-DDECOMPRESSOR_SOURCE=\"${PWD}/lib/${source}\"" \
+         -DDECOMPRESSOR_FUNCTION=${function} -o $HARNESS_DIRECTORY/harness-$name \
+         $HARNESS_DIRECTORY/decompress.c $HARNESS_DIRECTORY/main.c > $HARNESS_DIRECTORY/$name.log 2>&1; then
+      harnessBuilt+=($name)
+    fi
+  done
+  printf "Timing the kernel's decompressors built for this host: ${harnessBuilt[*]:-none}\n"
+
+  # Microseconds the kernel's decompressor for $1 takes to unpack $2 into $3
+  # (the original), or "-" when there's no harness for it or it failed
+  decompressTime()
+  {
+    if [[ ! -x $HARNESS_DIRECTORY/harness-$1 ]] || ! $HARNESS_DIRECTORY/harness-$1 $2 $3 2>> $HARNESS_DIRECTORY/$1.log; then
+      echo '-'
+    fi
+  }
+
+  # Compresses $2 with every available format into $BENCH_DIRECTORY/$1.*
+  # and prints "name size microseconds option" for each of them
+  benchmarkImage()
+  {
+    local entry name compress decompress option source function
+    for entry in "${compressors[@]}"; do
+      IFS='|' read name compress decompress option source function <<< "$entry"
+      if ! type ${compress%% *} > /dev/null 2>&1; then
+        continue
+      fi
+      $compress < $2 > $BENCH_DIRECTORY/$1.$name
+      echo $name $(stat -c %s $BENCH_DIRECTORY/$1.$name) $(decompressTime $name $BENCH_DIRECTORY/$1.$name $2) $option
+    done
+  }
+
+  # Prints the table, with the ramdisk formats the .config can't boot marked
+  benchmarkTable()
+  {
+    awk -v config=${buildDirectory}/.config -v ramdisk=$2 '
+      BEGIN {
+        while ((getline line < config) > 0)
+          if (line ~ /^CONFIG_RD_[A-Z0-9]*=y$/) { sub(/=y$/, "", line); enabled[line] = 1 }
+      }
+      { name[NR] = $1; size[NR] = $2; usec[NR] = $3; option[NR] = $4; if ($1 == "gzip") { gzipSize = $2; gzipUsec = $3 } }
+      END {
+        printf "%-8s %10s %8s %14s %9s  %s\n", "format", "size (KB)", "vs gzip", "unpack (ms)", "vs gzip", ramdisk ? "kernel support" : ""
+        for (i = 1; i <= NR; i++) {
+          if (usec[i] == "-") unpack = sprintf("%14s %9s", "n/a", "n/a")
+          else unpack = sprintf("%14.2f %8s", usec[i] / 1000, (gzipUsec != "-" && gzipUsec > 0) ? sprintf("%.0f%%", 100 * usec[i] / gzipUsec) : "n/a")
+          printf "%-8s %10.1f %7.0f%% %s  %s\n", name[i], size[i] / 1024, gzipSize ? 100 * size[i] / gzipSize : 0, unpack, !ramdisk ? "" : (option[i] in enabled) ? "yes" : "no (" option[i] " not set)"
+        }
+      }' $1
+  }
+
+  # vmlinux as the wrapper packs it (stripped ELF), for reference only
+  ${crossPrefix}objcopy -S ${buildDirectory}/vmlinux $BENCH_DIRECTORY/vmlinux.raw
+  benchmarkImage vmlinux $BENCH_DIRECTORY/vmlinux.raw > $BENCH_DIRECTORY/vmlinux.txt
+  printf "\nvmlinux ($(( $(stat -c %s $BENCH_DIRECTORY/vmlinux.raw) / 1024 )) KB stripped, the bootwrapper can only unpack gzip):\n"
+  benchmarkTable $BENCH_DIRECTORY/vmlinux.txt 0 | tee $BENCH_DIRECTORY/report.txt
+
+  if [[ ${buildImage} == 'zImage.initrd' ]]; then
+    # Unpacks the current ramdisk, whatever format it's already in
+    ramdiskFormat=''
+    for entry in "${compressors[@]}"; do
+      IFS='|' read name compress decompress option source function <<< "$entry"
+      if type ${compress%% *} > /dev/null 2>&1 && $decompress < $BOOT_DIRECTORY/ramdisk.image.gz > $BENCH_DIRECTORY/ramdisk.raw 2> /dev/null; then
+        ramdiskFormat=$name
+        break
+      fi
+    done
+    if [[ -z ${ramdiskFormat} ]]; then
+      printf "\nError, ramdisk.image.gz isn't in any format the host tools here can unpack\n"
+      printf "Quitting script...\n"
+      exit 1
+    fi
+
+    benchmarkImage ramdisk $BENCH_DIRECTORY/ramdisk.raw > $BENCH_DIRECTORY/ramdisk.txt
+    printf "\nramdisk ($(( $(stat -c %s $BENCH_DIRECTORY/ramdisk.raw) / 1024 )) KB unpacked):\n"
+    benchmarkTable $BENCH_DIRECTORY/ramdisk.txt 1 | tee -a $BENCH_DIRECTORY/report.txt
+
+    # The wrapper doesn't depend on the ramdisk, so the old images have to go
+    # before each rebuild; everything is put back the way it was afterwards
+    mkdir -p $BENCH_DIRECTORY/original
+    cp -p $BOOT_DIRECTORY/ramdisk.image.gz $BOOT_DIRECTORY/zImage.initrd* $BENCH_DIRECTORY/original/
+    printf "\nzImage.initrd with each ramdisk format:\n" | tee -a $BENCH_DIRECTORY/report.txt
+    while read name compressedSize unpackTime option; do
+      rm -f $BOOT_DIRECTORY/zImage.initrd*
+      cp $BENCH_DIRECTORY/ramdisk.$name $BOOT_DIRECTORY/ramdisk.image.gz
+      if make zImage.initrd "${makeFlags[@]}" < /dev/null > $BENCH_DIRECTORY/zImage.initrd.$name.log 2>&1; then
+        cp $BOOT_DIRECTORY/zImage.initrd $BENCH_DIRECTORY/zImage.initrd.$name
+        printf "%-8s %10.1f KB\n" $name $(awk -v bytes=$(stat -c %s $BENCH_DIRECTORY/zImage.initrd.$name) 'BEGIN { print bytes / 1024 }')
+      else
+        printf "%-8s failed, see $BENCH_DIRECTORY/zImage.initrd.$name.log\n" $name
+      fi
+    done < $BENCH_DIRECTORY/ramdisk.txt | tee -a $BENCH_DIRECTORY/report.txt
+    rm -f $BOOT_DIRECTORY/zImage.initrd*
+    cp -p $BENCH_DIRECTORY/original/* $BOOT_DIRECTORY/
+    rm -rf $BENCH_DIRECTORY/original
+  fi
+
+  rm -f $BENCH_DIRECTORY/*.raw
+  printf "\n(Images and the report are in: $BENCH_DIRECTORY)\n"
+  printf "To use another ramdisk format, enable it in the .config and replace ramdisk.image.gz\n"
+  printf "with the matching compressed image, the file name doesn't have to change.\n"
+fi
+#------------------------------------------------------------------------------
+
+
+# Boot test: boots the kernel in qemu with the serial port as the console and
+# takes the printk timestamps and initcall_debug times from the log.  The GC/Wii
+# bootwrapper (zImage) talks to the console's own hardware, which qemu doesn't
+# have, so the vmlinux inside it is booted directly (with the ramdisk, if any)
+# on a generic 750 machine.  That needs a kernel with the matching platform
+# support as well (CONFIG_PPC_PMAC for g3beige).  Every initcall gets the median
+# of 3 boots, which keeps the emulator's noise out of the comparison.
+if [[ ${bootTest} == 'yes' ]]; then
+  printf "\n\n- Boot Test -\n"
+  BOOTTEST_DIRECTORY="${buildDirectory}/boot-test"
+  BOOT_DIRECTORY="${buildDirectory}/arch/powerpc/boot"
+  mkdir -p $BOOTTEST_DIRECTORY
+  rm -f $BOOTTEST_DIRECTORY/boot.*.log $BOOTTEST_DIRECTORY/diff.txt
+
+  if ! type qemu-system-ppc > /dev/null 2>&1; then
+    printf "Error, qemu-system-ppc not found, skipping the boot test\n"
+  elif [[ ${qemuMachine} == 'g3beige' ]] && ! grep -q '^CONFIG_PPC_PMAC=y' ${buildDirectory}/.config; then
+    printf "CONFIG_PPC_PMAC isn't set, so this kernel can't boot on g3beige, skipping the boot test\n"
+    printf "(enable it in the .config, or pick a machine the kernel supports with '--qemu-machine')\n"
+  else
+    qemuFlags=(-M ${qemuMachine} -cpu 750 -m 88 -display none -monitor none -no-reboot)
+    if [[ ${buildImage} == 'zImage.initrd' ]]; then
+      qemuFlags+=(-initrd $BOOT_DIRECTORY/ramdisk.image.gz)
+    fi
+    bootArgs='console=ttyPZ0 console=ttyS0 printk.time=1 initcall_debug ignore_loglevel log_buf_len=1M panic=-1'
+    bootTimeout=120
+
+    # Stops at the end of the kernel's part of the boot (right before init
+    # runs), at a panic, or after bootTimeout seconds.  A boot without any
+    # serial output won't do better the next time, so that ends the test.
+    for bootRun in 1 2 3; do
+      bootLog=$BOOTTEST_DIRECTORY/boot.${bootRun}.log
+      : > $bootLog
+      qemu-system-ppc "${qemuFlags[@]}" -serial file:$bootLog -kernel ${buildDirectory}/vmlinux -append "${bootArgs}" > $BOOTTEST_DIRECTORY/qemu.log 2>&1 &
+      qemuPid=$!
+      for (( waited = 0; waited < bootTimeout; waited++ )); do
+        if ! kill -0 $qemuPid 2> /dev/null || grep -q -e 'Freeing unused kernel memory' -e 'Kernel panic' $bootLog 2> /dev/null; then
+          break
+        fi
+        sleep 1
+      done
+      kill $qemuPid 2> /dev/null
+      wait $qemuPid 2> /dev/null
+      printf "Boot ${bootRun}: $(grep -c 'initcall .* returned' $bootLog 2> /dev/null) initcalls"
+      if grep -q 'Kernel panic' $bootLog 2> /dev/null; then
+        printf " (kernel panic, see $bootLog)"
+      elif (( waited >= bootTimeout )); then
+        printf " (timed out after ${bootTimeout} seconds)"
+      fi
+      printf "\n"
+      if [[ ! -s $bootLog ]]; then
+        printf "No serial output from the kernel, not booting it again\n"
+        break
+      fi
+    done
+
+    # "name microseconds" per initcall and boot, "(boot)" is the timestamp of
+    # the end of the kernel's part of the boot (or of the last initcall)
+    for bootLog in $BOOTTEST_DIRECTORY/boot.*.log; do
+      tr -d '\r' < $bootLog | awk '
+        /^\[ *[0-9]+\.[0-9]+\]/ {
+          stamp = $0; sub(/^\[ */, "", stamp); sub(/\].*$/, "", stamp)
+          split(stamp, part, ".")
+          usecs = part[1] * 1000000 + part[2]
+        }
+        /initcall [^ ]+ returned -?[0-9]+ after [0-9]+ usecs/ {
+          for (i = 1; i < NF; i++)
+            if ($i == "initcall") name = $(i + 1)
+            else if ($i == "after") time = $(i + 1)
+          sub(/\+0x.*$/, "", name)
+          print name, time
+          bootEnd = usecs
+        }
+        /Freeing unused kernel memory/ && !freed { freed = 1; bootEnd = usecs }
+        END { if (bootEnd) print "(boot)", bootEnd }'
+    done | LC_ALL=C sort -k 1,1 -k 2,2n | awk '
+      function flush() {
+        if (count) print name, value[int((count + 1) / 2)]
+      }
+      $1 != name { flush(); name = $1; count = 0 }
+      { value[++count] = $2 }
+      END { flush() }' > $BOOTTEST_DIRECTORY/initcalls.txt
+
+    if [[ ! -s $BOOTTEST_DIRECTORY/initcalls.txt ]]; then
+      printf "No timestamps or initcalls in the boot logs, check $BOOTTEST_DIRECTORY/boot.1.log\n"
+      printf "(the kernel needs CONFIG_PRINTK and a serial console driver for the machine)\n"
+    else
+      awk '
+        $1 == "(boot)" { boot = $2; next }
+        { name[++n] = $1; time[n] = $2; total += $2 }
+        END {
+          printf "Kernel boot: %.3f s, %d initcalls taking %.3f s (median of %d boots)\n", boot / 1e6, n, total / 1e6, boots
+          printf "\nSlowest initcalls:\n%12s %7s  %s\n", "msecs", "share", "initcall"
+          fflush()
+
+          # The rows go out unsorted, sort puts the slowest first
+          sorter = "sort -k 1,1nr | head -n 25"
+          for (i = 1; i <= n; i++)
+            printf "%12.3f %6.1f%%  %s\n", time[i] / 1000, total ? 100 * time[i] / total : 0, name[i] | sorter
+          close(sorter)
+        }' boots=$(ls $BOOTTEST_DIRECTORY/boot.*.log | wc -l) $BOOTTEST_DIRECTORY/initcalls.txt > $BOOTTEST_DIRECTORY/report.txt
+
+      # An initcall only counts as a regression when it's both 20% and 1 ms
+      # slower, smaller changes are within what qemu varies from boot to boot
+      if [[ -f $BOOTTEST_DIRECTORY/baseline.txt ]]; then
+        awk '
+          FNR == NR { old[$1] = $2; next }
+          { new[$1] = $2 }
+          END {
+            for (name in new) {
+              if (!(name in old)) { printf "%-40s %12s %12.3f  new\n", name, "-", new[name] / 1000; continue }
+              delta = new[name] - old[name]
+              if (delta >= 1000 && delta * 5 >= old[name])
+                printf "%-40s %12.3f %12.3f  slower by %.3f ms\n", name, old[name] / 1000, new[name] / 1000, delta / 1000
+              else if (-delta >= 1000 && -delta * 5 >= old[name])
+                printf "%-40s %12.3f %12.3f  faster by %.3f ms\n", name, old[name] / 1000, new[name] / 1000, -delta / 1000
+            }
+            for (name in old)
+              if (!(name in new)) printf "%-40s %12.3f %12s  gone\n", name, old[name] / 1000, "-"
+          }' $BOOTTEST_DIRECTORY/baseline.txt $BOOTTEST_DIRECTORY/initcalls.txt | sort > $BOOTTEST_DIRECTORY/diff.txt
+      fi
+
+      cat $BOOTTEST_DIRECTORY/report.txt
+      if [[ -s $BOOTTEST_DIRECTORY/diff.txt ]]; then
+        printf "\nChanges against the baseline (milliseconds):\n%-40s %12s %12s\n" "initcall" "baseline" "now"
+        cat $BOOTTEST_DIRECTORY/diff.txt
+        if grep -q -e 'slower by' $BOOTTEST_DIRECTORY/diff.txt; then
+          printf "\nWarning, some initcalls are slower than in the baseline!\n"
+        fi
+      elif [[ -f $BOOTTEST_DIRECTORY/baseline.txt ]]; then
+        printf "\nNo initcall changed noticeably against the baseline\n"
+      elif [[ ${saveBootBaseline} != 'yes' ]]; then
+        printf "\nNo boot baseline yet, save one with '--save-boot-baseline'\n"
+      fi
+
+      if [[ ${saveBootBaseline} == 'yes' ]]; then
+        cp $BOOTTEST_DIRECTORY/initcalls.txt $BOOTTEST_DIRECTORY/baseline.txt
+        printf "Saved this build as the boot baseline\n"
+      fi
+    fi
+    printf "(Boot logs and the report are in: $BOOTTEST_DIRECTORY)\n"
+  fi
+fi
+#------------------------------------------------------------------------------
+
+
+while [[ -z ${useStrip} ]]
 do
   printf "\n\nReduce kernel size by removing extra debug data (stripping)?\n"
   printf "1) Yes, use SuperStrip (https://github.com/BR903/ELFkickers.git)\n"
@@ -329,20 +1463,10 @@ do
   echo -n "Response: "
   read opt5
   case $opt5 in
-    1) printf "\n\nSuperStrip selected...\n"
-      printf "Checking for an existing installation\n"
-      if [[ ! -e 'type sstrip' ]]; then # Use local copy of sstrip
-        printf "SuperStrip found, stripping the debug info out of the zImage / zImage.initrd.\n"
-        sstrip -z $zImageFile
-      else
-        printf "SuperStrip not found, stripping the debug info out of the zImage will\n"
-        printf "require a manual installation of SuperStrip (sstrip)\n"
-        printf "For more information, see: https://github.com/BR903/ELFkickers.git\n"
-        printf "Stripping has been skipped...\n"
-      fi
+    1) useStrip='yes'
       break;;
 
-    2) printf "\n\nNot stripping zImage / zImage.initrd...\n"
+    2) useStrip='no'
       break;;
 
     *) printf "\n\n$opt is an invalid option.\n"
@@ -352,11 +1476,27 @@ do
       ;;
   esac
 done
+
+if [[ ${useStrip} == 'yes' ]]; then
+  printf "\n\nSuperStrip selected...\n"
+  printf "Checking for an existing installation\n"
+  if type sstrip > /dev/null 2>&1; then
+    printf "SuperStrip found, stripping the debug info out of the zImage / zImage.initrd.\n"
+    sstrip -z $zImageFile
+  else
+    printf "SuperStrip not found, stripping the debug info out of the zImage will\n"
+    printf "require a manual installation of SuperStrip (sstrip)\n"
+    printf "For more information, see: https://github.com/BR903/ELFkickers.git\n"
+    printf "Stripping has been skipped...\n"
+  fi
+else
+  printf "\n\nNot stripping zImage / zImage.initrd...\n"
+fi
 #------------------------------------------------------------------------------
 
 
 # Sets modules folder path
-MOD_DIRECTORY='lib/modules'
+MOD_DIRECTORY="${buildDirectory}/lib/modules"
 
 # Removes modules directory if it already exist
 if [[ -d "$MOD_DIRECTORY" ]]; then
@@ -366,19 +1506,23 @@ fi
 
 #Creates the modules directory
 echo "Creating modules folder / adding contents into:" $MOD_DIRECTORY
-mkdir $MOD_DIRECTORY
+mkdir -p $MOD_DIRECTORY
 
-# Checks for modules and places them in a the modules folder
-find ! -path $MOD_DIRECTORY -name '*.ko' -exec cp -av {} $MOD_DIRECTORY \;
+# Checks for modules and places them in a the modules folder (out of tree
+# build folders are skipped so an in tree build doesn't collect their modules)
+find ${buildDirectory} \( -path $MOD_DIRECTORY -o -path ./build -o -path ${buildDirectory}/initramfs \) -prune -o -name '*.ko' -exec cp -av {} $MOD_DIRECTORY \;
 #------------------------------------------------------------------------------
 
 
 # Script finish message
 printf "\nDone! (Check to see if there were any errors above)\n\n"
-printf "The kernel (zImage) can be found in: 'arch/powerpc/boot'\n"
+if [[ ${useCcache} == 'yes' ]]; then
+  printf "ccache: %s\n\n" "${ccacheSummary}"
+fi
+printf "The kernel (zImage) can be found in: '${buildDirectory}/arch/powerpc/boot'\n"
 printf "Although the inclusion of headers, modules, and firmware are mostly non essential for basic use,\n"
 printf "it's recommended to include these.  At minimal, any built modules and the firmware should be\n"
-printf "included in their folders on the target device in the /lib/ folder (/lib/modules and /lib/firmware).\n\n"  
+printf "included in their folders on the target device in the /lib/ folder (/lib/modules and /lib/firmware).\n\n"
 echo "Kernel headers should be located in the folder:" $HDR_DIRECTORY
 printf "\nUsually kernel headers can be installed manually or by using a package manager instead...\n"
 echo "Firmware (if any) should be located in the folder:" $FMW_DIRECTORY
@@ -388,9 +1532,13 @@ printf "\nFirmware should be placed into the '/lib/firmware' folder of the targe
 echo "Modules (if any) should be located in the folder:" $MOD_DIRECTORY
 printf "\nModules should be placed into the '/lib/modules/KERNEL_VERSION_NUMBER' folder of\n"
 printf "the target system where KERNEL_VERSION_NUMBER is the numerical version of the kernel.\n"
-printf "\nWARNING: If using a ramdisk based kernel, remember to add the new modules / firmware \n"
-printf "into their appropriate folders in the ramdisk image and rebuild the kernel (with the\n"
-printf "same configuration) with the new ramdisk image.\n" 
+if [[ ${buildInitramfs} == 'yes' ]]; then
+  printf "\nThe modules and firmware are already in the initramfs of the zImage.initrd.\n"
+else
+  printf "\nWARNING: If using a ramdisk based kernel, remember to add the new modules / firmware \n"
+  printf "into their appropriate folders in the ramdisk image and rebuild the kernel (with the\n"
+  printf "same configuration) with the new ramdisk image (or use '--initramfs').\n"
+fi
 exit 0
 #
 # More info on the gcLinux cross compile tool can be found at the following website:
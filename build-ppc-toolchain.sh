@@ -0,0 +1,450 @@
+#!/bin/bash
+#
+# Linux Shell Script For Building A Modern GC/Wii PowerPC Cross Toolchain
+# Written by DeltaResero <deltaresero[at]zoho.com>
+#
+# Permission is hereby granted, free of charge, to any person obtaining a
+# copy of this software and associated documentation files (the "Software"),
+# to deal in the Software without restriction, including without limitation
+# on the rights to use, copy, modify, merge, publish, distribute, sub
+# license, and/or sell copies of the Software, and to permit persons to whom
+# the Software is furnished to do so, subject to the following conditions:
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+#
+#
+
+
+# Builds binutils, GCC (with LTO) and uClibc-ng for the GameCube / Wii 750
+# CPU into the same H-<host>/cross-powerpc-linux-uclibc style layout as the
+# included 2009 Buildroot toolchain (usr/bin/powerpc-linux-gcc and so on), so
+# build-gc-wii-kernel.sh can use it with "--compiler modern".
+usage()
+{
+  printf "Usage: %s [options]\n\n" "$0"
+  printf "  -o, --output DIR         install the toolchain into DIR (default:\n"
+  printf "                           H-<host>-pc-linux-gnu/cross-powerpc-linux-uclibc-ng)\n"
+  printf "  -s, --sources DIR        where the source archives are downloaded to and kept\n"
+  printf "                           (default: toolchain-sources)\n"
+  printf "  -j, --jobs N             number of parallel make jobs (default: number of processors)\n"
+  printf "      --binutils VERSION   binutils version (default: %s)\n" "${binutilsVersion}"
+  printf "      --gcc VERSION        GCC version (default: %s)\n" "${gccVersion}"
+  printf "      --uclibc VERSION     uClibc-ng version (default: %s)\n" "${uclibcVersion}"
+  printf "      --headers VERSION    Linux version the kernel headers are taken from (default: %s)\n" "${headersVersion}"
+  printf "  -k, --keep-work          keep the build folder (toolchain-work) afterwards\n"
+  printf "      --record-checksums   print the sourceChecksums lines for the archives that were\n"
+  printf "                           checked against their release site, to pin them in this script\n"
+  printf "  -h, --help               show this help and exit\n"
+}
+
+# GCC 4.9 is the newest GCC the 3.x GC/Wii kernels build with (their
+# compiler-gcc.h includes compiler-gcc<major>.h, and 3.x only has up to
+# compiler-gcc4.h), and it already has LTO.  The headers are from the oldest
+# of those kernels, so the C library doesn't use system calls they lack.
+binutilsVersion='2.32'
+gccVersion='4.9.4'
+gmpVersion='6.1.2'
+mpfrVersion='3.1.6'
+mpcVersion='1.0.3'
+uclibcVersion='1.0.31'
+headersVersion='3.0.101'
+outputDirectory=''
+sourceDirectory='toolchain-sources'
+numJobs=''
+keepWork='no'
+recordChecksums='no'
+
+# Pinned SHA256 of source archives.  An archive listed here has to match it;
+# any other archive is checked against what its release site publishes next
+# to it (see verifySource), and --record-checksums prints the lines to pin it.
+declare -A sourceChecksums=(
+)
+
+# Reads the command line options
+while [[ $# -gt 0 ]]; do
+  case $1 in
+    -o|--output|-s|--sources|-j|--jobs|--binutils|--gcc|--uclibc|--headers)
+      if [[ -z $2 ]]; then
+        printf "Error, option '%s' requires a value\n\n" "$1"
+        usage
+        exit 1
+      fi
+      case $1 in
+        -o|--output) outputDirectory=$2;;
+        -s|--sources) sourceDirectory=$2;;
+        -j|--jobs) numJobs=$2;;
+        --binutils) binutilsVersion=$2;;
+        --gcc) gccVersion=$2;;
+        --uclibc) uclibcVersion=$2;;
+        --headers) headersVersion=$2;;
+      esac
+      shift 2;;
+    -k|--keep-work) keepWork='yes'
+      shift;;
+    --record-checksums) recordChecksums='yes'
+      shift;;
+    -h|--help) usage
+      exit 0;;
+    *) printf "Error, unknown option '%s'\n\n" "$1"
+      usage
+      exit 1;;
+  esac
+done
+
+if [[ -n ${numJobs} && ! ${numJobs} =~ ^[1-9][0-9]*$ ]]; then
+  printf "Error, the number of jobs must be a positive number\n"
+  exit 1
+fi
+numProcessors=${numJobs:-$(grep -c ^processor /proc/cpuinfo)}
+
+for hostTool in gcc g++ make bison flex m4 perl tar xz bzip2 gzip sha256sum gpgv; do
+  if ! type ${hostTool} > /dev/null 2>&1; then
+    printf "Error, '${hostTool}' is needed to build the toolchain, install it first\n"
+    exit 1
+  fi
+done
+if type curl > /dev/null 2>&1; then
+  downloadCommand='curl -fL -o'
+elif type wget > /dev/null 2>&1; then
+  downloadCommand='wget -O'
+else
+  printf "Error, curl or wget is needed to download the sources\n"
+  exit 1
+fi
+#------------------------------------------------------------------------------
+
+
+# Everything is absolute, the build steps change folders.  A fixed locale,
+# time zone and SOURCE_DATE_EPOCH (and deterministic archives in binutils)
+# make two builds of the same versions come out the same.
+TARGET='powerpc-linux-uclibc'
+MACHINE_TYPE=$(uname -m)
+outputDirectory=${outputDirectory:-H-${MACHINE_TYPE}-pc-linux-gnu/cross-powerpc-linux-uclibc-ng}
+mkdir -p ${outputDirectory} ${sourceDirectory} || exit 1
+OUTPUT_DIRECTORY=$(cd ${outputDirectory} && pwd)
+SOURCE_DIRECTORY=$(cd ${sourceDirectory} && pwd)
+WORK_DIRECTORY="${PWD}/toolchain-work"
+LOG_DIRECTORY=$WORK_DIRECTORY/logs
+PREFIX=$OUTPUT_DIRECTORY/usr
+SYSROOT=$PREFIX/$TARGET/sysroot
+PKGVERSION="GC/Wii uClibc-ng ${uclibcVersion}"
+
+export LC_ALL=C TZ=UTC
+export SOURCE_DATE_EPOCH=${SOURCE_DATE_EPOCH:-1577836800}
+export PATH=$PREFIX/bin:$PATH
+unset CC CXX CFLAGS CXXFLAGS LDFLAGS CROSS_COMPILE ARCH
+
+printf "\nBuilding a ${TARGET} toolchain (binutils ${binutilsVersion}, GCC ${gccVersion}, uClibc-ng ${uclibcVersion}, Linux ${headersVersion} headers)\n"
+printf "into: ${OUTPUT_DIRECTORY}\n"
+printf "Number of parallel jobs: ${numProcessors}\n"
+#------------------------------------------------------------------------------
+
+
+# name, version, download URL (the archive name is the last part of the URL)
+sources=("binutils|${binutilsVersion}|https://ftp.gnu.org/gnu/binutils/binutils-${binutilsVersion}.tar.xz"
+         "gcc|${gccVersion}|https://ftp.gnu.org/gnu/gcc/gcc-${gccVersion}/gcc-${gccVersion}.tar.bz2"
+         "gmp|${gmpVersion}|https://ftp.gnu.org/gnu/gmp/gmp-${gmpVersion}.tar.xz"
+         "mpfr|${mpfrVersion}|https://ftp.gnu.org/gnu/mpfr/mpfr-${mpfrVersion}.tar.xz"
+         "mpc|${mpcVersion}|https://ftp.gnu.org/gnu/mpc/mpc-${mpcVersion}.tar.gz"
+         "uClibc-ng|${uclibcVersion}|https://downloads.uclibc-ng.org/releases/${uclibcVersion}/uClibc-ng-${uclibcVersion}.tar.xz"
+         "linux|${headersVersion}|https://cdn.kernel.org/pub/linux/kernel/v${headersVersion%%.*}.x/linux-${headersVersion}.tar.xz")
+
+# Downloads $1 into $2 unless it's already there
+downloadFile()
+{
+  if [[ ! -f $2 ]]; then
+    printf "Downloading ${1##*/}\n"
+    if ! ${downloadCommand} $2.part $1; then
+      rm -f $2.part
+      printf "Error, downloading $1 failed\n"
+      exit 1
+    fi
+    mv $2.part $2
+  fi
+}
+
+# Checks an archive against what its release site publishes: the GNU archives
+# against their signature (with the GNU keyring), uClibc-ng against its .sha256
+# and Linux against the sha256sums.asc of its kernel.org folder
+verifySource()
+{
+  local name=$1 url=$2 archive=${2##*/} published
+  case ${name} in
+    uClibc-ng)
+      downloadFile $url.sha256 $SOURCE_DIRECTORY/$archive.sha256
+      published=$(awk '{ print $1; exit }' $SOURCE_DIRECTORY/$archive.sha256);;
+    linux)
+      downloadFile ${url%/*}/sha256sums.asc $SOURCE_DIRECTORY/linux-v${headersVersion%%.*}.x-sha256sums.asc
+      published=$(awk -v archive=$archive '$2 == archive { print $1 }' $SOURCE_DIRECTORY/linux-v${headersVersion%%.*}.x-sha256sums.asc);;
+    *)
+      downloadFile https://ftp.gnu.org/gnu/gnu-keyring.gpg $SOURCE_DIRECTORY/gnu-keyring.gpg
+      downloadFile $url.sig $SOURCE_DIRECTORY/$archive.sig
+      gpgv --keyring $SOURCE_DIRECTORY/gnu-keyring.gpg $SOURCE_DIRECTORY/$archive.sig $SOURCE_DIRECTORY/$archive > /dev/null 2>&1
+      return;;
+  esac
+  [[ -n ${published} && ${published} == $(sha256sum < $SOURCE_DIRECTORY/$archive | cut -d' ' -f1) ]]
+}
+
+# Every archive has to match its pinned checksum, or what its release site publishes
+printf "\n- Sources -\n"
+newChecksums=()
+for entry in "${sources[@]}"; do
+  IFS='|' read name version url <<< "$entry"
+  archive=${url##*/}
+  downloadFile $url $SOURCE_DIRECTORY/$archive
+  checksum=$(sha256sum < $SOURCE_DIRECTORY/$archive | cut -d' ' -f1)
+  if [[ -n ${sourceChecksums[$archive]} ]]; then
+    if [[ ${checksum} != ${sourceChecksums[$archive]} ]]; then
+      printf "Error, ${archive} doesn't match its pinned checksum, remove it to download it again\n"
+      exit 1
+    fi
+  elif verifySource ${name} ${url}; then
+    printf "${archive} matches its published signature / checksum\n"
+    newChecksums+=("  [${archive}]='${checksum}'")
+  else
+    printf "Error, ${archive} doesn't match the signature / checksum published for it\n"
+    printf "Remove it (and the .sig / .sha256 files next to it) to download them again\n"
+    exit 1
+  fi
+done
+if [[ ${recordChecksums} == 'yes' && ${#newChecksums[@]} -gt 0 ]]; then
+  printf "To pin these archives, add this to sourceChecksums in build-ppc-toolchain.sh:\n"
+  printf "%s\n" "${newChecksums[@]}"
+fi
+
+rm -rf $WORK_DIRECTORY
+mkdir -p $LOG_DIRECTORY
+for entry in "${sources[@]}"; do
+  IFS='|' read name version url <<< "$entry"
+  tar -xf $SOURCE_DIRECTORY/${url##*/} -C $WORK_DIRECTORY || exit 1
+done
+
+# GCC builds its own copies of these, so nothing is needed from the host
+ln -s ../gmp-${gmpVersion} $WORK_DIRECTORY/gcc-${gccVersion}/gmp
+ln -s ../mpfr-${mpfrVersion} $WORK_DIRECTORY/gcc-${gccVersion}/mpfr
+ln -s ../mpc-${mpcVersion} $WORK_DIRECTORY/gcc-${gccVersion}/mpc
+#------------------------------------------------------------------------------
+
+
+# Runs a build step with its output in the log folder, showing the end of
+# the log when it fails
+runStep()
+{
+  local name=$1
+  shift
+  printf "  ${name}\n"
+  if ! "$@" > $LOG_DIRECTORY/${name}.log 2>&1; then
+    printf "\nError, the '${name}' step failed, the end of $LOG_DIRECTORY/${name}.log:\n\n"
+    tail -n 25 $LOG_DIRECTORY/${name}.log
+    printf "\nQuitting script...\n"
+    exit 1
+  fi
+}
+
+installHeaders()
+(
+  set -e
+  cd $WORK_DIRECTORY/linux-${headersVersion}
+  make ARCH=powerpc INSTALL_HDR_PATH=$SYSROOT/usr headers_install
+)
+
+buildBinutils()
+(
+  set -e
+  mkdir -p $WORK_DIRECTORY/build-binutils
+  cd $WORK_DIRECTORY/build-binutils
+  ../binutils-${binutilsVersion}/configure --target=${TARGET} --prefix=$PREFIX \
+    --with-sysroot=$SYSROOT --with-pkgversion="${PKGVERSION}" \
+    --enable-plugins --enable-lto --enable-deterministic-archives \
+    --disable-multilib --disable-nls --disable-werror --disable-gdb --disable-sim
+  make -j${numProcessors} MAKEINFO=true
+  make install-strip MAKEINFO=true
+)
+
+# The settings both GCC builds share: a 750 with its FPU as the default CPU,
+# and LTO (with the linker plugin from binutils above).  GCC 4.9 predates C++11
+# being the default of the host compiler, so it's built as C++98.
+gccFlags=(--target=${TARGET} --prefix=$PREFIX --with-sysroot=$SYSROOT
+          --with-pkgversion="${PKGVERSION}" --with-cpu=750 --with-float=hard
+          --enable-lto --enable-plugin --disable-multilib --disable-nls
+          --disable-libsanitizer --disable-libquadmath)
+
+# Just enough of a C compiler to build the C library with
+buildGccBootstrap()
+(
+  set -e
+  mkdir -p $WORK_DIRECTORY/build-gcc-bootstrap
+  cd $WORK_DIRECTORY/build-gcc-bootstrap
+  CXX="g++ -std=gnu++98" ../gcc-${gccVersion}/configure "${gccFlags[@]}" --enable-languages=c \
+    --without-headers --with-newlib --disable-shared --disable-threads \
+    --disable-libssp --disable-libatomic --disable-libgomp --disable-decimal-float
+  make -j${numProcessors} MAKEINFO=true all-gcc all-target-libgcc
+  make MAKEINFO=true install-gcc install-target-libgcc
+)
+
+# uClibc-ng is configured from a short list of settings on top of allnoconfig,
+# and is compiled with its functions and data in their own sections, so static
+# programs linked with --gc-sections only take the parts of libc they use
+buildUclibc()
+(
+  set -e
+  cd $WORK_DIRECTORY/uClibc-ng-${uclibcVersion}
+  cat > uclibc.config <<EOF
+TARGET_powerpc=y
+TARGET_ARCH="powerpc"
+CONFIG_CLASSIC=y
+ARCH_BIG_ENDIAN=y
+ARCH_WANTS_BIG_ENDIAN=y
+ARCH_USE_MMU=y
+UCLIBC_HAS_FPU=y
+UCLIBC_HAS_FLOATS=y
+DO_C99_MATH=y
+KERNEL_HEADERS="$SYSROOT/usr/include"
+HAVE_SHARED=y
+LDSO_LDD_SUPPORT=y
+LDSO_CACHE_SUPPORT=y
+LDSO_RUNPATH=y
+LDSO_SEARCH_INTERP_PATH=y
+UCLIBC_HAS_THREADS_NATIVE=y
+UCLIBC_HAS_TLS=y
+UCLIBC_HAS_SSP=y
+UCLIBC_HAS_IPV4=y
+UCLIBC_HAS_IPV6=y
+UCLIBC_HAS_RESOLVER_SUPPORT=y
+UCLIBC_HAS_LIBUTIL=y
+UCLIBC_HAS_CRYPT=y
+UCLIBC_HAS_SHA256_CRYPT_IMPL=y
+UCLIBC_HAS_SHA512_CRYPT_IMPL=y
+UCLIBC_HAS_SHADOW=y
+UCLIBC_HAS_UTMPX=y
+UCLIBC_HAS_WCHAR=y
+UCLIBC_HAS_CTYPE_TABLES=y
+UCLIBC_HAS_PRINTF_M_SPEC=y
+UCLIBC_HAS_ERRNO_MESSAGES=y
+UCLIBC_HAS_SIGNUM_MESSAGES=y
+UCLIBC_HAS_GETOPT_LONG=y
+UCLIBC_HAS_GNU_GETOPT=y
+UCLIBC_HAS_REGEX=y
+UCLIBC_HAS_FNMATCH=y
+UCLIBC_HAS_GLOB=y
+UCLIBC_HAS_GNU_GLOB=y
+UCLIBC_HAS_FTW=y
+UCLIBC_HAS_NFTW=y
+UCLIBC_HAS_OBSTACK=y
+UCLIBC_HAS_BSD_ERR=y
+UCLIBC_SUSV3_LEGACY=y
+UCLIBC_SUSV4_LEGACY=y
+RUNTIME_PREFIX="/"
+DEVEL_PREFIX="/usr/"
+CROSS_COMPILER_PREFIX="${TARGET}-"
+UCLIBC_EXTRA_CFLAGS="-mcpu=750 -ffunction-sections -fdata-sections"
+DOSTRIP=y
+EOF
+  make ARCH=powerpc KCONFIG_ALLCONFIG=uclibc.config allnoconfig
+  for setting in TARGET_powerpc HAVE_SHARED UCLIBC_HAS_THREADS_NATIVE UCLIBC_HAS_WCHAR; do
+    grep -q "^${setting}=y" .config || { echo "uClibc-ng didn't take ${setting}=y"; exit 1; }
+  done
+  make -j${numProcessors} ARCH=powerpc CROSS_COMPILE=${TARGET}- PREFIX=$SYSROOT
+  make ARCH=powerpc CROSS_COMPILE=${TARGET}- PREFIX=$SYSROOT install
+)
+
+buildGcc()
+(
+  set -e
+  mkdir -p $WORK_DIRECTORY/build-gcc
+  cd $WORK_DIRECTORY/build-gcc
+  CXX="g++ -std=gnu++98" ../gcc-${gccVersion}/configure "${gccFlags[@]}" --enable-languages=c,c++ \
+    --enable-shared --enable-threads=posix --enable-tls --enable-__cxa_atexit \
+    --enable-libssp --disable-libstdcxx-pch
+  make -j${numProcessors} MAKEINFO=true
+  make MAKEINFO=true install-strip
+)
+
+printf "\n- Building -\n"
+runStep headers installHeaders
+runStep binutils buildBinutils
+runStep gcc-bootstrap buildGccBootstrap
+runStep uclibc-ng buildUclibc
+runStep gcc buildGcc
+#------------------------------------------------------------------------------
+
+
+# Same names as the Buildroot toolchain: powerpc-linux-* next to the
+# powerpc-linux-uclibc-* tools and a usr/powerpc-linux folder
+(
+  cd $PREFIX/bin
+  for tool in ${TARGET}-*; do
+    ln -sf ${tool} powerpc-linux-${tool#${TARGET}-}
+  done
+  ln -sfn ${TARGET} $PREFIX/powerpc-linux
+)
+
+# Checks the compiler works, and shows what LTO and section garbage
+# collection save on a small static program
+printf "\n- Checking -\n"
+TEST_DIRECTORY=$WORK_DIRECTORY/test
+mkdir -p $TEST_DIRECTORY
+cat > $TEST_DIRECTORY/hello.c <<EOF
+#include <stdio.h>
+#include <string.h>
+
+static int unused(const char *text)
+{
+  return (int)strlen(text);
+}
+
+int main(int argc, char *argv[])
+{
+  printf("Hello from the %s\n", argc > 1 ? argv[1] : "GameCube / Wii");
+  return argc > 5 ? unused(argv[0]) : 0;
+}
+EOF
+if ! $PREFIX/bin/${TARGET}-gcc -Os -static -o $TEST_DIRECTORY/hello $TEST_DIRECTORY/hello.c ||
+   ! $PREFIX/bin/${TARGET}-gcc -Os -static -flto -ffunction-sections -fdata-sections -Wl,--gc-sections \
+       -o $TEST_DIRECTORY/hello-gc $TEST_DIRECTORY/hello.c ||
+   ! $PREFIX/bin/${TARGET}-gcc -Os -o $TEST_DIRECTORY/hello-shared $TEST_DIRECTORY/hello.c; then
+  printf "Error, the new compiler can't build a test program\n"
+  exit 1
+fi
+if ! $PREFIX/bin/${TARGET}-readelf -h $TEST_DIRECTORY/hello | grep -q 'PowerPC$'; then
+  printf "Error, the test program isn't a 32-bit PowerPC binary\n"
+  exit 1
+fi
+$PREFIX/bin/${TARGET}-strip $TEST_DIRECTORY/hello $TEST_DIRECTORY/hello-gc $TEST_DIRECTORY/hello-shared
+printf "Static hello world (stripped): %d bytes with -Os, %d bytes with -Os -flto and --gc-sections\n" \
+  $(stat -c %s $TEST_DIRECTORY/hello) $(stat -c %s $TEST_DIRECTORY/hello-gc)
+printf "Dynamically linked: %d bytes (interpreter: %s)\n" $(stat -c %s $TEST_DIRECTORY/hello-shared) \
+  "$($PREFIX/bin/${TARGET}-readelf -l $TEST_DIRECTORY/hello-shared | sed -n 's/.*interpreter: \(.*\)]/\1/p')"
+
+# What went into this toolchain, then fixed timestamps on everything
+{
+  printf "PowerPC toolchain for GC/Wii Linux, built by build-ppc-toolchain.sh\n\n"
+  printf "This toolchain was built with:\n\n"
+  printf "\tbinutils-${binutilsVersion}\n\tgcc-${gccVersion}\n\tgmp-${gmpVersion}\n\tmpfr-${mpfrVersion}\n"
+  printf "\tmpc-${mpcVersion}\n\tuClibc-ng-${uclibcVersion}\n\tlinux-${headersVersion} (headers)\n\n"
+  printf "Sources (sha256):\n\n"
+  for entry in "${sources[@]}"; do
+    IFS='|' read name version url <<< "$entry"
+    archive=${url##*/}
+    printf "%s  %s\n" "$(sha256sum < $SOURCE_DIRECTORY/$archive | cut -d' ' -f1)" "${archive}"
+  done
+  printf "\nGCC was configured with:\n\n"
+  $PREFIX/bin/${TARGET}-gcc -v 2>&1 | sed -n 's/^Configured with: //p' | sed "s|${OUTPUT_DIRECTORY}|<toolchain>|g"
+  printf "\nThe default CPU is the 750 (-mcpu=750).  For smaller programs use:\n\n"
+  printf "\t-Os -flto -ffunction-sections -fdata-sections -Wl,--gc-sections\n"
+} > $OUTPUT_DIRECTORY/README.gc-wii-linux
+find $OUTPUT_DIRECTORY -exec touch -h -d @${SOURCE_DATE_EPOCH} {} +
+
+if [[ ${keepWork} != 'yes' ]]; then
+  rm -rf $WORK_DIRECTORY
+fi
+
+printf "\nDone!  The toolchain is in: ${OUTPUT_DIRECTORY}\n"
+printf "Build a kernel with it using: ./build-gc-wii-kernel.sh --compiler modern\n"
+printf "(or add ${PREFIX}/bin to the PATH and use powerpc-linux-gcc)\n"